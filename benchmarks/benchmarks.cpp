@@ -0,0 +1,322 @@
+#include <benchmark/benchmark.h>
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "optional.hpp"
+
+template <typename T>
+class value_and_flag {
+ public:
+  value_and_flag()
+      : mValue()
+      , mHasValue(false) {}
+
+  value_and_flag(nullopt_t)
+      : mValue()
+      , mHasValue(false) {}
+
+  value_and_flag(const T& value)
+      : mValue(value)
+      , mHasValue(true) {}
+
+  bool has_value() const {
+    return mHasValue;
+  }
+
+  const T& value() const {
+    if (not mHasValue) {
+      throw bad_optional_access();
+    }
+    return mValue;
+  }
+
+  const T& operator*() const {
+    return mValue;
+  }
+
+  void swap(value_and_flag& other) {
+    using std::swap;
+    swap(mValue, other.mValue);
+    swap(mHasValue, other.mHasValue);
+  }
+
+  friend bool operator==(const value_and_flag& a, const value_and_flag& b) {
+    if (a.mHasValue && b.mHasValue) {
+      return a.mValue == b.mValue;
+    }
+    return a.mHasValue == b.mHasValue;
+  }
+
+  friend bool operator==(const value_and_flag& a, const T& b) {
+    return a.mHasValue && a.mValue == b;
+  }
+
+  friend bool operator==(const value_and_flag& a, nullopt_t) {
+    return not a.mHasValue;
+  }
+
+  friend bool operator<(const value_and_flag& a, const value_and_flag& b) {
+    if (a.mHasValue && b.mHasValue) {
+      return a.mValue < b.mValue;
+    }
+    return !a.mHasValue && b.mHasValue;
+  }
+
+  friend bool operator<(const value_and_flag& a, const T& b) {
+    return not a.mHasValue || a.mValue < b;
+  }
+
+  friend bool operator<(const value_and_flag&, nullopt_t) {
+    return false;
+  }
+
+ private:
+  T mValue;
+  bool mHasValue;
+};
+
+struct optionalcpp_implementation {
+  template <typename T>
+  struct optional_type {
+    typedef optional<T> type;
+  };
+
+  static nullopt_t none() {
+    return nullopt;
+  }
+};
+
+struct std_implementation {
+  template <typename T>
+  struct optional_type {
+    typedef std::optional<T> type;
+  };
+
+  static std::nullopt_t none() {
+    return std::nullopt;
+  }
+};
+
+struct value_and_flag_implementation {
+  template <typename T>
+  struct optional_type {
+    typedef value_and_flag<T> type;
+  };
+
+  static nullopt_t none() {
+    return nullopt;
+  }
+};
+
+template <typename T>
+T anyValue();
+
+template <>
+int anyValue<int>() {
+  return 42;
+}
+
+template <>
+std::string anyValue<std::string>() {
+  return "a string which is too long for the small string optimization";
+}
+
+template <>
+std::vector<int> anyValue<std::vector<int> >() {
+  return std::vector<int>(64, 42);
+}
+
+template <typename Implementation, typename T>
+void BM_Construction(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  const T value = anyValue<T>();
+  for (auto _ : state) {
+    Optional x(value);
+    benchmark::DoNotOptimize(x);
+  }
+  state.counters["sizeof"] = sizeof(Optional);
+}
+
+template <typename Implementation, typename T>
+void BM_DefaultConstruction(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  for (auto _ : state) {
+    Optional x;
+    benchmark::DoNotOptimize(x);
+  }
+  state.counters["sizeof"] = sizeof(Optional);
+}
+
+template <typename Implementation, typename T>
+void BM_Copy(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional x(anyValue<T>());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(x);
+    Optional y(x);
+    benchmark::DoNotOptimize(y);
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_Move(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional x(anyValue<T>());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(x);
+    Optional y(std::move(x));
+    benchmark::DoNotOptimize(y);
+    x = std::move(y);
+  }
+}
+
+template <typename Implementation, typename T, bool LeftHasValue,
+          bool RightHasValue>
+void BM_Swap(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a = LeftHasValue ? Optional(anyValue<T>()) : Optional();
+  Optional b = RightHasValue ? Optional(anyValue<T>()) : Optional();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(b);
+    a.swap(b);
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_EqualOptional(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a(anyValue<T>());
+  Optional b(anyValue<T>());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(b);
+    benchmark::DoNotOptimize(a == b);
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_EqualValue(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a(anyValue<T>());
+  T b = anyValue<T>();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(b);
+    benchmark::DoNotOptimize(a == b);
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_EqualNullopt(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a(anyValue<T>());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(a == Implementation::none());
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_LessOptional(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a(anyValue<T>());
+  Optional b(anyValue<T>());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(b);
+    benchmark::DoNotOptimize(a < b);
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_LessValue(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a(anyValue<T>());
+  T b = anyValue<T>();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(b);
+    benchmark::DoNotOptimize(a < b);
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_LessNullopt(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a(anyValue<T>());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(a < Implementation::none());
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_Value(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a(anyValue<T>());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(a.value());
+  }
+}
+
+template <typename Implementation, typename T>
+void BM_Dereference(benchmark::State& state) {
+  typedef typename Implementation::template optional_type<T>::type Optional;
+  Optional a(anyValue<T>());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(*a);
+  }
+}
+
+#define OPTIONALCPP_BENCHMARK(Benchmark, T)                     \
+  BENCHMARK_TEMPLATE(Benchmark, optionalcpp_implementation, T); \
+  BENCHMARK_TEMPLATE(Benchmark, std_implementation, T);         \
+  BENCHMARK_TEMPLATE(Benchmark, value_and_flag_implementation, T)
+
+#define OPTIONALCPP_SWAP_BENCHMARK(T, LeftHasValue, RightHasValue)            \
+  BENCHMARK_TEMPLATE(BM_Swap, optionalcpp_implementation, T, LeftHasValue,    \
+                     RightHasValue);                                          \
+  BENCHMARK_TEMPLATE(BM_Swap, std_implementation, T, LeftHasValue,            \
+                     RightHasValue);                                          \
+  BENCHMARK_TEMPLATE(BM_Swap, value_and_flag_implementation, T, LeftHasValue, \
+                     RightHasValue)
+
+OPTIONALCPP_BENCHMARK(BM_DefaultConstruction, int);
+OPTIONALCPP_BENCHMARK(BM_DefaultConstruction, std::string);
+OPTIONALCPP_BENCHMARK(BM_Construction, int);
+OPTIONALCPP_BENCHMARK(BM_Construction, std::string);
+OPTIONALCPP_BENCHMARK(BM_Copy, int);
+OPTIONALCPP_BENCHMARK(BM_Copy, std::vector<int>);
+OPTIONALCPP_BENCHMARK(BM_Move, int);
+OPTIONALCPP_BENCHMARK(BM_Move, std::vector<int>);
+
+OPTIONALCPP_SWAP_BENCHMARK(int, false, false);
+OPTIONALCPP_SWAP_BENCHMARK(int, false, true);
+OPTIONALCPP_SWAP_BENCHMARK(int, true, false);
+OPTIONALCPP_SWAP_BENCHMARK(int, true, true);
+OPTIONALCPP_SWAP_BENCHMARK(std::string, false, false);
+OPTIONALCPP_SWAP_BENCHMARK(std::string, false, true);
+OPTIONALCPP_SWAP_BENCHMARK(std::string, true, false);
+OPTIONALCPP_SWAP_BENCHMARK(std::string, true, true);
+
+OPTIONALCPP_BENCHMARK(BM_EqualOptional, int);
+OPTIONALCPP_BENCHMARK(BM_EqualOptional, std::string);
+OPTIONALCPP_BENCHMARK(BM_EqualValue, int);
+OPTIONALCPP_BENCHMARK(BM_EqualValue, std::string);
+OPTIONALCPP_BENCHMARK(BM_EqualNullopt, int);
+OPTIONALCPP_BENCHMARK(BM_LessOptional, int);
+OPTIONALCPP_BENCHMARK(BM_LessOptional, std::string);
+OPTIONALCPP_BENCHMARK(BM_LessValue, int);
+OPTIONALCPP_BENCHMARK(BM_LessValue, std::string);
+OPTIONALCPP_BENCHMARK(BM_LessNullopt, int);
+
+OPTIONALCPP_BENCHMARK(BM_Value, int);
+OPTIONALCPP_BENCHMARK(BM_Dereference, int);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,245 @@
+#include <benchmark/benchmark.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "atomic_optional.hpp"
+#include "optional.hpp"
+#include "padded_optional.hpp"
+
+struct Payload {
+  int64_t a;
+  int64_t b;
+  int64_t c;
+  int64_t d;
+};
+
+template <typename T>
+T makeValue(int64_t i);
+
+template <>
+int makeValue<int>(int64_t i) {
+  return static_cast<int>(i);
+}
+
+template <>
+Payload makeValue<Payload>(int64_t i) {
+  const Payload payload = {i, i, i, i};
+  return payload;
+}
+
+template <typename T>
+class mutex_optional {
+ public:
+  optional<T> load() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mValue;
+  }
+
+  void store(const optional<T>& value) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mValue = value;
+  }
+
+ private:
+  mutable std::mutex mMutex;
+  optional<T> mValue;
+};
+
+struct atomic_implementation {
+  template <typename T>
+  struct slot_type {
+    typedef atomic_optional<T> type;
+  };
+};
+
+struct mutex_implementation {
+  template <typename T>
+  struct slot_type {
+    typedef mutex_optional<T> type;
+  };
+};
+
+// Samples every 64th operation of one thread.
+class latency_recorder {
+ public:
+  static const int64_t sampling_interval = 64;
+
+  latency_recorder() {
+    mSamples.reserve(1 << 16);
+  }
+
+  template <typename Operation>
+  void run(int64_t iteration, Operation operation) {
+    if (iteration % sampling_interval != 0) {
+      operation();
+      return;
+    }
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    operation();
+    mSamples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count());
+  }
+
+  const std::vector<int64_t>& samples() const {
+    return mSamples;
+  }
+
+ private:
+  std::vector<int64_t> mSamples;
+};
+
+// Merges the samples of all threads of a run, so that the percentiles are
+// taken over all stores and all loads instead of being averaged per thread.
+class latency_collector {
+ public:
+  // Called by every thread after its benchmark loop. Thread 0 waits for the
+  // samples of all other threads, reports the percentiles once and resets
+  // the collector for the next run.
+  void merge(benchmark::State& state, const latency_recorder& recorder,
+             bool store) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    std::vector<int64_t>& samples = store ? mStores : mLoads;
+    samples.insert(samples.end(), recorder.samples().begin(),
+                   recorder.samples().end());
+    ++mMerged;
+    mAllMerged.notify_all();
+    if (state.thread_index() != 0) {
+      return;
+    }
+    mAllMerged.wait(lock, [&] { return mMerged == state.threads(); });
+    report(state, "store", mStores);
+    report(state, "load", mLoads);
+    mStores.clear();
+    mLoads.clear();
+    mMerged = 0;
+  }
+
+ private:
+  std::mutex mMutex;
+  std::condition_variable mAllMerged;
+  std::vector<int64_t> mStores;
+  std::vector<int64_t> mLoads;
+  int mMerged = 0;
+
+  // Only thread 0 sets these counters, so summing them over the threads
+  // reports the merged percentiles unchanged.
+  static void report(benchmark::State& state, const std::string& name,
+                     std::vector<int64_t>& samples) {
+    if (samples.empty()) {
+      return;
+    }
+    std::sort(samples.begin(), samples.end());
+    state.counters[name + "_p50_ns"] = percentile(samples, 0.5);
+    state.counters[name + "_p99_ns"] = percentile(samples, 0.99);
+    state.counters[name + "_p999_ns"] = percentile(samples, 0.999);
+  }
+
+  static double percentile(const std::vector<int64_t>& samples,
+                           double fraction) {
+    const std::size_t index =
+        std::min(samples.size() - 1,
+                 static_cast<std::size_t>(fraction * double(samples.size())));
+    return double(samples[index]);
+  }
+};
+
+// The first range(0) threads publish new values while all other threads poll
+// the slot.
+template <typename Implementation, typename T>
+void BM_PublishPoll(benchmark::State& state) {
+  typedef typename Implementation::template slot_type<T>::type Slot;
+  static Slot slot;
+  static latency_collector collector;
+  latency_recorder latencies;
+  const bool producer = state.thread_index() < state.range(0);
+  int64_t iteration = 0;
+  for (auto _ : state) {
+    if (producer) {
+      latencies.run(iteration, [&] {
+        slot.store(iteration % 16 == 0 ? optional<T>()
+                                       : optional<T>(makeValue<T>(iteration)));
+      });
+    } else {
+      latencies.run(iteration, [&] {
+        optional<T> value = slot.load();
+        benchmark::DoNotOptimize(value);
+      });
+    }
+    ++iteration;
+  }
+  collector.merge(state, latencies, producer);
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Registers 1, 2, 4, 8 and 16 producers, each with up to 16 threads in total.
+template <typename Implementation, typename T>
+int registerPublishPoll(const char* name) {
+  for (int producers = 1; producers <= 16; producers *= 2) {
+    benchmark::RegisterBenchmark(name, BM_PublishPoll<Implementation, T>)
+        ->ArgName("producers")
+        ->Arg(producers)
+        ->ThreadRange(producers, 16)
+        ->UseRealTime();
+  }
+  return 0;
+}
+
+struct packed_layout {
+  template <typename T>
+  struct slot_type {
+    typedef optional<T> type;
+  };
+};
+
+struct padded_layout {
+  template <typename T>
+  struct slot_type {
+    typedef padded_optional<T> type;
+  };
+};
+
+// Every thread updates its own element of a shared array; with the packed
+// layout neighbouring elements share a cache line.
+template <typename Layout>
+void BM_FalseSharing(benchmark::State& state) {
+  typedef typename Layout::template slot_type<int64_t>::type Slot;
+  static Slot slots[64];
+  Slot& slot = slots[state.thread_index() % 64];
+  slot = optional<int64_t>(0);
+  for (auto _ : state) {
+    slot = optional<int64_t>(*slot + 1);
+    benchmark::DoNotOptimize(slot);
+    benchmark::ClobberMemory();
+  }
+  state.counters["sizeof"] =
+      benchmark::Counter(sizeof(Slot), benchmark::Counter::kAvgThreads);
+  state.SetItemsProcessed(state.iterations());
+}
+
+static const int publishPollRegistrations[] = {
+    registerPublishPoll<atomic_implementation, int>(
+        "BM_PublishPoll<atomic_implementation, int>"),
+    registerPublishPoll<mutex_implementation, int>(
+        "BM_PublishPoll<mutex_implementation, int>"),
+    registerPublishPoll<atomic_implementation, Payload>(
+        "BM_PublishPoll<atomic_implementation, Payload>"),
+    registerPublishPoll<mutex_implementation, Payload>(
+        "BM_PublishPoll<mutex_implementation, Payload>")};
+
+BENCHMARK_TEMPLATE(BM_FalseSharing, packed_layout)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FalseSharing, padded_layout)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,75 @@
+# Counts the instructions and the conditional jumps of every probe_* function
+# in ASSEMBLY and compares them with the counts stored in GOLDEN. Fails if a
+# probe got larger, got more conditional jumps or is unknown. Counting the
+# jumps catches a branch that replaces arithmetic of the same length. With
+# UPDATE set, GOLDEN is rewritten instead.
+
+file(STRINGS ${ASSEMBLY} lines)
+
+set(functions)
+set(function)
+foreach(line IN LISTS lines)
+  if(line MATCHES "^_?(probe_[A-Za-z0-9_]+):")
+    set(function ${CMAKE_MATCH_1})
+    list(APPEND functions ${function})
+    set(count_${function} 0)
+    set(jumps_${function} 0)
+  elseif(function AND line MATCHES "^[ \t]+(\\.cfi_endproc|\\.size)")
+    set(function)
+  elseif(function AND line MATCHES "^[ \t]+[a-z]")
+    math(EXPR count_${function} "${count_${function}} + 1")
+    if(line MATCHES "^[ \t]+j([a-z]+)[ \t]" AND NOT CMAKE_MATCH_1 STREQUAL "mp")
+      math(EXPR jumps_${function} "${jumps_${function}} + 1")
+    endif()
+  endif()
+endforeach()
+
+if(UPDATE)
+  set(content)
+  foreach(function IN LISTS functions)
+    string(APPEND content "${function} ${count_${function}} ${jumps_${function}}\n")
+  endforeach()
+  file(WRITE ${GOLDEN} "${content}")
+  message(STATUS "Wrote instruction and jump counts to ${GOLDEN}")
+  return()
+endif()
+
+if(NOT EXISTS ${GOLDEN})
+  message(FATAL_ERROR "No instruction counts for this compiler and standard: ${GOLDEN}\n"
+                      "Create them with the update_codegen_golden target.")
+endif()
+
+file(STRINGS ${GOLDEN} golden_lines)
+foreach(line IN LISTS golden_lines)
+  if(line MATCHES "^([A-Za-z0-9_]+) ([0-9]+) ([0-9]+)$")
+    set(golden_${CMAKE_MATCH_1} ${CMAKE_MATCH_2})
+    set(golden_jumps_${CMAKE_MATCH_1} ${CMAKE_MATCH_3})
+  endif()
+endforeach()
+
+set(failed OFF)
+foreach(function IN LISTS functions)
+  set(count ${count_${function}})
+  set(golden ${golden_${function}})
+  set(jumps ${jumps_${function}})
+  set(golden_jumps ${golden_jumps_${function}})
+  if(NOT DEFINED golden_${function})
+    message(SEND_ERROR "${function}: ${count} instructions, no golden value")
+    set(failed ON)
+  elseif(count GREATER golden)
+    message(SEND_ERROR "${function}: ${count} instructions, expected at most ${golden}")
+    set(failed ON)
+  elseif(jumps GREATER golden_jumps)
+    message(SEND_ERROR "${function}: ${jumps} conditional jumps, expected at most ${golden_jumps}")
+    set(failed ON)
+  elseif(count LESS golden OR jumps LESS golden_jumps)
+    message(STATUS "${function}: ${count} instructions, ${jumps} conditional jumps, "
+                   "improved from ${golden} and ${golden_jumps}")
+  else()
+    message(STATUS "${function}: ${count} instructions, ${jumps} conditional jumps")
+  endif()
+endforeach()
+
+if(failed)
+  message(FATAL_ERROR "Generated code of optional grew or gained branches, see ${ASSEMBLY}")
+endif()
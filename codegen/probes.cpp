@@ -0,0 +1,42 @@
+#include <string>
+
+#include "optional.hpp"
+
+extern "C" {
+
+bool probe_has_value(const optional<int>& x) {
+  return x.has_value();
+}
+
+int probe_value(const optional<int>& x) {
+  return x.value();
+}
+
+bool probe_equal_nullopt(const optional<int>& x) {
+  return x == nullopt;
+}
+
+bool probe_equal_optional(const optional<int>& a, const optional<int>& b) {
+  return a == b;
+}
+
+bool probe_less_optional(const optional<int>& a, const optional<int>& b) {
+  return a < b;
+}
+
+void probe_reset(optional<int>& x) {
+  x.reset();
+}
+
+void probe_reset_string(optional<std::string>& x) {
+  x.reset();
+}
+
+void probe_swap(optional<int>& a, optional<int>& b) {
+  a.swap(b);
+}
+
+void probe_swap_string(optional<std::string>& a, optional<std::string>& b) {
+  a.swap(b);
+}
+}
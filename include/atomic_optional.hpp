@@ -0,0 +1,291 @@
+#ifndef OPTIONALCPP_ATOMIC_OPTIONAL_HPP
+#define OPTIONALCPP_ATOMIC_OPTIONAL_HPP
+
+#if __cplusplus < 201103L
+#error "atomic_optional requires C++11"
+#endif
+
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "optional.hpp"
+
+namespace optional_detail {
+
+inline void spin_pause() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+template <typename T>
+struct atomic_representation {
+  static const std::size_t words = (sizeof(T) + 1 + 7) / 8;
+
+  typedef uint64_t type[words];
+
+  static void encode(const optional<T>& value, type& out) {
+    unsigned char bytes[sizeof(type)] = {};
+    if (value.has_value()) {
+      std::memcpy(bytes, &(*value), sizeof(T));
+      bytes[sizeof(T)] = 1;
+    }
+    std::memcpy(out, bytes, sizeof(type));
+  }
+
+  static optional<T> decode(const type& in) {
+    unsigned char bytes[sizeof(type)];
+    std::memcpy(bytes, in, sizeof(type));
+    if (bytes[sizeof(T)] == 0) {
+      return nullopt;
+    }
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return *reinterpret_cast<const T*>(&value);
+  }
+};
+
+template <typename T, bool = atomic_representation<T>::words == 1>
+class atomic_optional_storage {
+ public:
+  static const bool uses_seqlock = false;
+
+  bool is_lock_free() const {
+    return mWord.is_lock_free();
+  }
+
+  optional<T> load(std::memory_order order) const {
+    const uint64_t word[1] = {mWord.load(order)};
+    return representation::decode(word);
+  }
+
+  void store(const optional<T>& desired, std::memory_order order) {
+    mWord.store(encode(desired), order);
+  }
+
+  optional<T> exchange(const optional<T>& desired, std::memory_order order) {
+    const uint64_t word[1] = {mWord.exchange(encode(desired), order)};
+    return representation::decode(word);
+  }
+
+  bool compare_exchange(optional<T>& expected, const optional<T>& desired,
+                        std::memory_order order) {
+    uint64_t word[1] = {encode(expected)};
+    if (mWord.compare_exchange_strong(word[0], encode(desired), order)) {
+      return true;
+    }
+    expected = representation::decode(word);
+    return false;
+  }
+
+ protected:
+  atomic_optional_storage()
+      : mWord(0) {}
+
+ private:
+  typedef atomic_representation<T> representation;
+
+  std::atomic<uint64_t> mWord;
+
+  static uint64_t encode(const optional<T>& value) {
+    uint64_t word[1];
+    representation::encode(value, word);
+    return word[0];
+  }
+};
+
+// Guarded by a sequence counter, loads have at least acquire and stores at
+// least release semantics. Sequentially consistent operations add a full
+// fence where a store followed by a load could otherwise be reordered.
+template <typename T>
+class atomic_optional_storage<T, false> {
+ public:
+  static const bool uses_seqlock = true;
+
+  bool is_lock_free() const {
+    return false;
+  }
+
+  optional<T> load(std::memory_order order) const {
+    words_type words;
+    fenceIfSequential(order);
+    for (;;) {
+      const uint32_t sequence = mSequence.load(std::memory_order_acquire);
+      if (sequence & 1) {
+        spin_pause();
+        continue;
+      }
+      readWords(words);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (mSequence.load(std::memory_order_relaxed) == sequence) {
+        return representation::decode(words);
+      }
+    }
+  }
+
+  void store(const optional<T>& desired, std::memory_order order) {
+    words_type words;
+    representation::encode(desired, words);
+    const uint32_t sequence = lock();
+    writeWords(words);
+    unlock(sequence);
+    fenceIfSequential(order);
+  }
+
+  optional<T> exchange(const optional<T>& desired, std::memory_order order) {
+    words_type words;
+    words_type previous;
+    representation::encode(desired, words);
+    fenceIfSequential(order);
+    const uint32_t sequence = lock();
+    readWords(previous);
+    writeWords(words);
+    unlock(sequence);
+    fenceIfSequential(order);
+    return representation::decode(previous);
+  }
+
+  bool compare_exchange(optional<T>& expected, const optional<T>& desired,
+                        std::memory_order order) {
+    words_type expectedWords;
+    words_type desiredWords;
+    words_type current;
+    representation::encode(expected, expectedWords);
+    representation::encode(desired, desiredWords);
+    fenceIfSequential(order);
+    const uint32_t sequence = lock();
+    readWords(current);
+    const bool equal =
+        std::memcmp(current, expectedWords, sizeof(words_type)) == 0;
+    if (equal) {
+      writeWords(desiredWords);
+    }
+    unlock(sequence);
+    fenceIfSequential(order);
+    if (not equal) {
+      expected = representation::decode(current);
+    }
+    return equal;
+  }
+
+ protected:
+  atomic_optional_storage()
+      : mSequence(0) {
+    for (std::size_t i = 0; i < representation::words; ++i) {
+      mWords[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  typedef atomic_representation<T> representation;
+  typedef typename representation::type words_type;
+
+  std::atomic<uint32_t> mSequence;
+  std::atomic<uint64_t> mWords[representation::words];
+
+  uint32_t lock() {
+    uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+    for (;;) {
+      if ((sequence & 1) == 0 &&
+          mSequence.compare_exchange_weak(sequence, sequence + 1,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed)) {
+        std::atomic_thread_fence(std::memory_order_release);
+        return sequence;
+      }
+      spin_pause();
+      sequence = mSequence.load(std::memory_order_relaxed);
+    }
+  }
+
+  void unlock(uint32_t sequence) {
+    mSequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  static void fenceIfSequential(std::memory_order order) {
+    if (order == std::memory_order_seq_cst) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  void readWords(words_type& words) const {
+    for (std::size_t i = 0; i < representation::words; ++i) {
+      words[i] = mWords[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  void writeWords(const words_type& words) {
+    for (std::size_t i = 0; i < representation::words; ++i) {
+      mWords[i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+};
+
+template <typename T, bool Packed>
+const bool atomic_optional_storage<T, Packed>::uses_seqlock;
+
+template <typename T>
+const bool atomic_optional_storage<T, false>::uses_seqlock;
+
+}  // namespace optional_detail
+
+template <typename T>
+class atomic_optional : private optional_detail::atomic_optional_storage<T> {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "atomic_optional requires a trivially copyable type");
+
+  typedef optional_detail::atomic_optional_storage<T> storage_base;
+
+ public:
+  typedef T value_type;
+
+  using storage_base::is_lock_free;
+  using storage_base::uses_seqlock;
+
+  atomic_optional() {}
+
+  atomic_optional(nullopt_t) {}
+
+  atomic_optional(const optional<T>& value) {
+    store(value, std::memory_order_relaxed);
+  }
+
+  atomic_optional(const atomic_optional&) = delete;
+  atomic_optional& operator=(const atomic_optional&) = delete;
+
+  optional<T> load(
+      std::memory_order order = std::memory_order_seq_cst) const {
+    return storage_base::load(order);
+  }
+
+  void store(const optional<T>& desired,
+             std::memory_order order = std::memory_order_seq_cst) {
+    storage_base::store(desired, order);
+  }
+
+  optional<T> exchange(const optional<T>& desired,
+                       std::memory_order order = std::memory_order_seq_cst) {
+    return storage_base::exchange(desired, order);
+  }
+
+  void reset(std::memory_order order = std::memory_order_seq_cst) {
+    storage_base::store(nullopt, order);
+  }
+
+  bool compare_exchange(optional<T>& expected, const optional<T>& desired,
+                        std::memory_order order = std::memory_order_seq_cst) {
+    return storage_base::compare_exchange(expected, desired, order);
+  }
+
+  operator optional<T>() const {
+    return load();
+  }
+};
+
+#endif  // OPTIONALCPP_ATOMIC_OPTIONAL_HPP
@@ -0,0 +1,322 @@
+#ifndef OPTIONALCPP_COMPACT_OPTIONAL_HPP
+#define OPTIONALCPP_COMPACT_OPTIONAL_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#include "optional.hpp"
+
+template <typename T, T Value>
+struct value_sentinel {
+  static OPTIONALCPP_CONSTEXPR T empty_value() {
+    return Value;
+  }
+
+  static OPTIONALCPP_CONSTEXPR bool is_empty(const T& value) {
+    return value == Value;
+  }
+};
+
+template <typename T>
+struct nan_sentinel {
+  static OPTIONALCPP_CONSTEXPR T empty_value() {
+    return std::numeric_limits<T>::quiet_NaN();
+  }
+
+  static OPTIONALCPP_CONSTEXPR bool is_empty(const T& value) {
+    return value != value;
+  }
+};
+
+template <typename T>
+struct null_sentinel {
+  static OPTIONALCPP_CONSTEXPR T empty_value() {
+    return 0;
+  }
+
+  static OPTIONALCPP_CONSTEXPR bool is_empty(const T& value) {
+    return value == 0;
+  }
+};
+
+// An optional that marks the empty state with a sentinel value of T chosen
+// by Policy instead of a flag. The sentinel itself cannot be stored: an
+// optional engaged with it, e.g. compact_optional<int, value_sentinel<int,
+// -1> >(-1), reads back as empty. Debug builds assert on every path that
+// engages the optional.
+template <typename T, typename Policy>
+class compact_optional : public optional_detail::comparison_operators<
+                             compact_optional<T, Policy> > {
+ public:
+  typedef T value_type;
+
+  OPTIONALCPP_CONSTEXPR compact_optional()
+      : mValue(Policy::empty_value()) {}
+
+  OPTIONALCPP_CONSTEXPR compact_optional(nullopt_t)
+      : mValue(Policy::empty_value()) {}
+
+  OPTIONALCPP_CONSTEXPR compact_optional(const T& value)
+      : mValue(engaging(value)) {}
+
+#if __cplusplus >= 201103L
+  constexpr compact_optional(T&& value)
+      : mValue(engaging(std::move(value))) {}
+
+  template <typename... Args>
+  OPTIONALCPP_CONSTEXPR14 explicit compact_optional(in_place_t,
+                                                    Args&&... args)
+      : mValue(std::forward<Args>(args)...) {
+    assert(has_value());
+  }
+#else
+  explicit compact_optional(in_place_t)
+      : mValue() {
+    assert(has_value());
+  }
+
+#define OPTIONALCPP_IN_PLACE_CONSTRUCTOR(N)                         \
+  template <OPTIONALCPP_TYPENAMES_##N>                              \
+  explicit compact_optional(in_place_t, OPTIONALCPP_PARAMETERS_##N) \
+      : mValue(OPTIONALCPP_ARGUMENTS_##N) {                         \
+    assert(has_value());                                            \
+  }
+
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_IN_PLACE_CONSTRUCTOR)
+
+#undef OPTIONALCPP_IN_PLACE_CONSTRUCTOR
+#endif
+
+  compact_optional& operator=(nullopt_t) {
+    reset();
+    return *this;
+  }
+
+#if __cplusplus >= 201103L
+  template <typename U = T,
+            typename = typename std::enable_if<
+                optional_detail::value_assignment<T, U>::value>::type>
+  compact_optional& operator=(U&& value) {
+    mValue = std::forward<U>(value);
+    assert(has_value());
+    return *this;
+  }
+#else
+  template <typename U>
+  typename optional_detail::enable_if<
+      not optional_detail::is_optional_like<U>::value,
+      compact_optional&>::type
+  operator=(const U& value) {
+    mValue = value;
+    assert(has_value());
+    return *this;
+  }
+#endif
+
+  OPTIONALCPP_CONSTEXPR bool has_value() const {
+    return not Policy::is_empty(mValue);
+  }
+
+  OPTIONALCPP_CONSTEXPR operator bool() const {
+    return has_value();
+  }
+
+  const T& value() const {
+    checkAccess();
+    return mValue;
+  }
+
+  T& value() {
+    checkAccess();
+    return mValue;
+  }
+
+  OPTIONALCPP_CONSTEXPR const T& operator*() const {
+    return mValue;
+  }
+
+  OPTIONALCPP_CONSTEXPR14 T& operator*() {
+    return mValue;
+  }
+
+#if __cplusplus >= 201103L
+  constexpr const T& value_or(const T& defaultValue) const& {
+    return has_value() ? mValue : defaultValue;
+  }
+
+  template <typename U, typename = typename std::enable_if<not(
+                            std::is_lvalue_reference<U>::value &&
+                            std::is_same<typename std::decay<U>::type,
+                                         T>::value)>::type>
+  constexpr T value_or(U&& defaultValue) const& {
+    return has_value() ? mValue
+                       : static_cast<T>(static_cast<U&&>(defaultValue));
+  }
+
+  template <typename U>
+  OPTIONALCPP_CONSTEXPR14 T value_or(U&& defaultValue) && {
+    return has_value() ? std::move(mValue)
+                       : static_cast<T>(static_cast<U&&>(defaultValue));
+  }
+#else
+  template <typename U>
+  T value_or(const U& defaultValue) const {
+    return has_value() ? mValue : static_cast<T>(defaultValue);
+  }
+#endif
+
+  OPTIONALCPP_CONSTEXPR const T* operator->() const {
+    return &mValue;
+  }
+
+  T* operator->() {
+    return &mValue;
+  }
+
+#if __cplusplus >= 201103L
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14 typename optional_detail::invoke_result<F, T&>::type
+  and_then(F&& f) & {
+    typedef typename optional_detail::invoke_result<F, T&>::type result;
+    return has_value() ? std::forward<F>(f)(mValue) : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14
+      typename optional_detail::invoke_result<F, const T&>::type
+      and_then(F&& f) const& {
+    typedef typename optional_detail::invoke_result<F, const T&>::type result;
+    return has_value() ? std::forward<F>(f)(mValue) : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14 typename optional_detail::invoke_result<F, T&&>::type
+  and_then(F&& f) && {
+    typedef typename optional_detail::invoke_result<F, T&&>::type result;
+    return has_value() ? std::forward<F>(f)(std::move(mValue)) : result();
+  }
+
+  // The result has no sentinel for its value type, so it is an optional.
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14
+      optional<typename optional_detail::invoke_result<F, T&>::type>
+      transform(F&& f) & {
+    typedef optional<typename optional_detail::invoke_result<F, T&>::type>
+        result;
+    return has_value() ? result(std::forward<F>(f)(mValue)) : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14
+      optional<typename optional_detail::invoke_result<F, const T&>::type>
+      transform(F&& f) const& {
+    typedef optional<
+        typename optional_detail::invoke_result<F, const T&>::type>
+        result;
+    return has_value() ? result(std::forward<F>(f)(mValue)) : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14
+      optional<typename optional_detail::invoke_result<F, T&&>::type>
+      transform(F&& f) && {
+    typedef optional<typename optional_detail::invoke_result<F, T&&>::type>
+        result;
+    return has_value() ? result(std::forward<F>(f)(std::move(mValue)))
+                       : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14 compact_optional or_else(F&& f) const& {
+    return has_value() ? *this : std::forward<F>(f)();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14 compact_optional or_else(F&& f) && {
+    return has_value() ? std::move(*this) : std::forward<F>(f)();
+  }
+
+  void swap(compact_optional& other) noexcept(
+      optional_detail::is_nothrow_swappable<T>::value) {
+#else
+  void swap(compact_optional& other) {
+#endif
+    using std::swap;
+    swap(mValue, other.mValue);
+  }
+
+  void reset() {
+    mValue = Policy::empty_value();
+  }
+
+#if __cplusplus >= 201103L
+  template <typename... Args>
+  T& emplace(Args&&... args) {
+    mValue = T(std::forward<Args>(args)...);
+    assert(has_value());
+    return mValue;
+  }
+#else
+  T& emplace() {
+    mValue = T();
+    assert(has_value());
+    return mValue;
+  }
+
+#define OPTIONALCPP_EMPLACE(N)             \
+  template <OPTIONALCPP_TYPENAMES_##N>     \
+  T& emplace(OPTIONALCPP_PARAMETERS_##N) { \
+    mValue = T(OPTIONALCPP_ARGUMENTS_##N); \
+    assert(has_value());                   \
+    return mValue;                         \
+  }
+
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_EMPLACE)
+
+#undef OPTIONALCPP_EMPLACE
+#endif
+
+#if __cplusplus >= 201103L
+  friend void swap(compact_optional& a, compact_optional& b) noexcept(
+      noexcept(a.swap(b))) {
+#else
+  friend void swap(compact_optional& a, compact_optional& b) {
+#endif
+    a.swap(b);
+  }
+
+ private:
+  T mValue;
+
+#if __cplusplus >= 201103L
+  template <typename U>
+  static constexpr U&& engaging(U&& value) {
+    return assert(not Policy::is_empty(value)), static_cast<U&&>(value);
+  }
+#else
+  static const T& engaging(const T& value) {
+    assert(not Policy::is_empty(value));
+    return value;
+  }
+#endif
+
+  void checkAccess() const {
+    optional_detail::check_access(has_value());
+  }
+};
+
+namespace optional_detail {
+
+template <typename T, typename Policy>
+struct optional_layout<compact_optional<T, Policy> > {
+  static const std::size_t value_bytes = sizeof(T);
+  static const std::size_t state_bytes = 0;
+  static const bool uses_sentinel = true;
+  static const bool is_trivially_copyable =
+      optional_detail::is_trivially_copyable<T>::value;
+};
+
+}  // namespace optional_detail
+
+#endif  // OPTIONALCPP_COMPACT_OPTIONAL_HPP
@@ -0,0 +1,433 @@
+#ifndef OPTIONALCPP_INDIRECT_OPTIONAL_HPP
+#define OPTIONALCPP_INDIRECT_OPTIONAL_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+
+#include "optional.hpp"
+
+template <typename T, typename Alloc = std::allocator<T> >
+class indirect_optional;
+
+namespace optional_detail {
+
+template <typename T, typename Alloc>
+struct branchless_comparable<indirect_optional<T, Alloc> > : false_type {};
+
+// Keeps a stateless allocator from adding to the size of the pointer.
+template <typename T, typename Alloc>
+struct indirect_storage : Alloc {
+  T* mPointer;
+
+  indirect_storage(const Alloc& allocator)
+      : Alloc(allocator), mPointer(0) {}
+
+  Alloc& allocator() {
+    return *this;
+  }
+
+  const Alloc& allocator() const {
+    return *this;
+  }
+};
+
+// The allocator_traits properties that indirect_optional follows. Before
+// C++11 they are the defaults of allocator_traits: the allocator is copied
+// on copy construction and does not propagate on assignment or swap.
+template <typename Alloc>
+struct allocator_propagation {
+#if __cplusplus >= 201103L
+  typedef std::allocator_traits<Alloc> traits;
+  typedef bool_constant<
+      traits::propagate_on_container_copy_assignment::value>
+      on_copy_assignment;
+  typedef bool_constant<
+      traits::propagate_on_container_move_assignment::value>
+      on_move_assignment;
+  typedef bool_constant<traits::propagate_on_container_swap::value> on_swap;
+
+  static Alloc select_on_copy(const Alloc& allocator) {
+    return traits::select_on_container_copy_construction(allocator);
+  }
+#else
+  typedef false_type on_copy_assignment;
+  typedef false_type on_move_assignment;
+  typedef false_type on_swap;
+
+  static Alloc select_on_copy(const Alloc& allocator) {
+    return allocator;
+  }
+#endif
+};
+
+}  // namespace optional_detail
+
+// An optional that keeps its value in memory obtained from Alloc, such as an
+// arena or a pool, and stores only a pointer to it. The memory is allocated
+// when the optional becomes engaged and returned to the allocator on reset.
+template <typename T, typename Alloc>
+class indirect_optional : public optional_detail::comparison_operators<
+                              indirect_optional<T, Alloc> > {
+  typedef optional_detail::allocator_propagation<Alloc> propagation;
+
+ public:
+  typedef T value_type;
+  typedef Alloc allocator_type;
+
+  indirect_optional()
+      : mStorage(Alloc()) {}
+
+  indirect_optional(nullopt_t)
+      : mStorage(Alloc()) {}
+
+  explicit indirect_optional(const Alloc& allocator)
+      : mStorage(allocator) {}
+
+  indirect_optional(const indirect_optional& other)
+      : mStorage(propagation::select_on_copy(other.get_allocator())) {
+    if (other.has_value()) {
+      constructValue(*other);
+    }
+  }
+
+#if __cplusplus >= 201103L
+  // Takes over the allocation of other, which is left empty.
+  indirect_optional(indirect_optional&& other) noexcept
+      : mStorage(std::move(other.mStorage.allocator())) {
+    std::swap(mStorage.mPointer, other.mStorage.mPointer);
+  }
+
+  indirect_optional(const T& value, const Alloc& allocator = Alloc())
+      : mStorage(allocator) {
+    constructValue(value);
+  }
+
+  indirect_optional(T&& value, const Alloc& allocator = Alloc())
+      : mStorage(allocator) {
+    constructValue(std::move(value));
+  }
+
+  template <typename... Args>
+  explicit indirect_optional(in_place_t, Args&&... args)
+      : mStorage(Alloc()) {
+    constructValue(std::forward<Args>(args)...);
+  }
+#else
+  indirect_optional(const T& value, const Alloc& allocator = Alloc())
+      : mStorage(allocator) {
+    constructValue(value);
+  }
+
+  explicit indirect_optional(in_place_t)
+      : mStorage(Alloc()) {
+    constructValue();
+  }
+
+#define OPTIONALCPP_IN_PLACE_CONSTRUCTOR(N)                          \
+  template <OPTIONALCPP_TYPENAMES_##N>                               \
+  explicit indirect_optional(in_place_t, OPTIONALCPP_PARAMETERS_##N) \
+      : mStorage(Alloc()) {                                          \
+    constructValue(OPTIONALCPP_ARGUMENTS_##N);                       \
+  }
+
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_IN_PLACE_CONSTRUCTOR)
+
+#undef OPTIONALCPP_IN_PLACE_CONSTRUCTOR
+#endif
+
+  ~indirect_optional() {
+    reset();
+  }
+
+  // Assigning between engaged optionals reuses the allocation of the target.
+  indirect_optional& operator=(const indirect_optional& other) {
+    copyAssign(other, typename propagation::on_copy_assignment());
+    return *this;
+  }
+
+#if __cplusplus >= 201103L
+  indirect_optional& operator=(indirect_optional&& other) noexcept(
+      propagation::on_move_assignment::value) {
+    moveAssign(other, typename propagation::on_move_assignment());
+    return *this;
+  }
+#endif
+
+  indirect_optional& operator=(nullopt_t) {
+    reset();
+    return *this;
+  }
+
+  // An engaged optional assigns to its value and keeps its allocation.
+#if __cplusplus >= 201103L
+  template <typename U = T,
+            typename = typename std::enable_if<
+                optional_detail::value_assignment<T, U>::value>::type>
+  indirect_optional& operator=(U&& value) {
+    if (has_value()) {
+      **this = std::forward<U>(value);
+    } else {
+      constructValue(std::forward<U>(value));
+    }
+    return *this;
+  }
+#else
+  template <typename U>
+  typename optional_detail::enable_if<
+      not optional_detail::is_optional_like<U>::value,
+      indirect_optional&>::type
+  operator=(const U& value) {
+    if (has_value()) {
+      **this = value;
+    } else {
+      constructValue(value);
+    }
+    return *this;
+  }
+#endif
+
+  allocator_type get_allocator() const {
+    return mStorage.allocator();
+  }
+
+  bool has_value() const {
+    return mStorage.mPointer != 0;
+  }
+
+  operator bool() const {
+    return has_value();
+  }
+
+  const T& value() const {
+    checkAccess();
+    return *mStorage.mPointer;
+  }
+
+  T& value() {
+    checkAccess();
+    return *mStorage.mPointer;
+  }
+
+  const T& operator*() const {
+    return *mStorage.mPointer;
+  }
+
+  T& operator*() {
+    return *mStorage.mPointer;
+  }
+
+  template <typename U>
+  T value_or(const U& defaultValue) const {
+    return has_value() ? *mStorage.mPointer : static_cast<T>(defaultValue);
+  }
+
+  const T* operator->() const {
+    return mStorage.mPointer;
+  }
+
+  T* operator->() {
+    return mStorage.mPointer;
+  }
+
+  // Exchanges the pointers, together with the allocators that own them if
+  // these propagate on swap. Otherwise the allocators have to be equal.
+  void swap(indirect_optional& other) {
+    swapAllocators(other, typename propagation::on_swap());
+    std::swap(mStorage.mPointer, other.mStorage.mPointer);
+  }
+
+  void reset() {
+    if (has_value()) {
+      destructValue();
+    }
+  }
+
+#if __cplusplus >= 201103L
+  template <typename... Args>
+  T& emplace(Args&&... args) {
+    reset();
+    constructValue(std::forward<Args>(args)...);
+    return **this;
+  }
+#else
+  T& emplace() {
+    reset();
+    constructValue();
+    return **this;
+  }
+
+#define OPTIONALCPP_EMPLACE(N)                 \
+  template <OPTIONALCPP_TYPENAMES_##N>         \
+  T& emplace(OPTIONALCPP_PARAMETERS_##N) {     \
+    reset();                                   \
+    constructValue(OPTIONALCPP_ARGUMENTS_##N); \
+    return **this;                             \
+  }
+
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_EMPLACE)
+
+#undef OPTIONALCPP_EMPLACE
+#endif
+
+  friend void swap(indirect_optional& a, indirect_optional& b) {
+    a.swap(b);
+  }
+
+ private:
+#if __cplusplus >= 201103L
+  typedef std::allocator_traits<Alloc> allocator_traits;
+#endif
+
+  optional_detail::indirect_storage<T, Alloc> mStorage;
+
+  void checkAccess() const {
+    optional_detail::check_access(has_value());
+  }
+
+  // The value allocated by the old allocator is returned to it first.
+  void copyAssign(const indirect_optional& other, optional_detail::true_type) {
+    if (get_allocator() != other.get_allocator()) {
+      reset();
+    }
+    mStorage.allocator() = other.mStorage.allocator();
+    copyAssign(other, optional_detail::false_type());
+  }
+
+  void copyAssign(const indirect_optional& other, optional_detail::false_type) {
+    if (not other.has_value()) {
+      reset();
+    } else if (has_value()) {
+      **this = *other;
+    } else {
+      constructValue(*other);
+    }
+  }
+
+#if __cplusplus >= 201103L
+  void moveAssign(indirect_optional& other, optional_detail::true_type) {
+    reset();
+    mStorage.allocator() = std::move(other.mStorage.allocator());
+    std::swap(mStorage.mPointer, other.mStorage.mPointer);
+  }
+
+  // Memory from an unequal allocator cannot be taken over, so the value is
+  // moved instead.
+  void moveAssign(indirect_optional& other, optional_detail::false_type) {
+    if (get_allocator() == other.get_allocator()) {
+      reset();
+      std::swap(mStorage.mPointer, other.mStorage.mPointer);
+    } else if (not other.has_value()) {
+      reset();
+    } else if (has_value()) {
+      **this = std::move(*other);
+    } else {
+      constructValue(std::move(*other));
+    }
+  }
+#endif
+
+  void swapAllocators(indirect_optional& other, optional_detail::true_type) {
+    using std::swap;
+    swap(mStorage.allocator(), other.mStorage.allocator());
+  }
+
+  void swapAllocators(indirect_optional& other, optional_detail::false_type) {
+    assert(get_allocator() == other.get_allocator());
+    (void)other;
+  }
+
+  // Returns the memory to the allocator if constructing the value throws.
+  struct allocation_guard {
+    indirect_optional& mOwner;
+    T* mPointer;
+
+    explicit allocation_guard(indirect_optional& owner)
+        : mOwner(owner), mPointer(owner.allocate()) {}
+
+    ~allocation_guard() {
+      if (mPointer != 0) {
+        mOwner.deallocate(mPointer);
+      }
+    }
+
+    T* release() {
+      T* pointer = mPointer;
+      mPointer = 0;
+      return pointer;
+    }
+  };
+
+  T* allocate() {
+#if __cplusplus >= 201103L
+    return allocator_traits::allocate(mStorage.allocator(), 1);
+#else
+    return mStorage.allocator().allocate(1);
+#endif
+  }
+
+  void deallocate(T* pointer) {
+#if __cplusplus >= 201103L
+    allocator_traits::deallocate(mStorage.allocator(), pointer, 1);
+#else
+    mStorage.allocator().deallocate(pointer, 1);
+#endif
+  }
+
+#if __cplusplus >= 201103L
+  template <typename... Args>
+  void constructValue(Args&&... args) {
+    allocation_guard guard(*this);
+    allocator_traits::construct(mStorage.allocator(), guard.mPointer,
+                                std::forward<Args>(args)...);
+    mStorage.mPointer = guard.release();
+  }
+
+  void destructValue() {
+    allocator_traits::destroy(mStorage.allocator(), mStorage.mPointer);
+    deallocate(mStorage.mPointer);
+    mStorage.mPointer = 0;
+  }
+#else
+  void constructValue() {
+    allocation_guard guard(*this);
+    new (guard.mPointer) T();
+    mStorage.mPointer = guard.release();
+  }
+
+#define OPTIONALCPP_CONSTRUCT_VALUE(N)                 \
+  template <OPTIONALCPP_TYPENAMES_##N>                 \
+  void constructValue(OPTIONALCPP_PARAMETERS_##N) {    \
+    allocation_guard guard(*this);                     \
+    new (guard.mPointer) T(OPTIONALCPP_ARGUMENTS_##N); \
+    mStorage.mPointer = guard.release();               \
+  }
+
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_CONSTRUCT_VALUE)
+
+#undef OPTIONALCPP_CONSTRUCT_VALUE
+
+  void destructValue() {
+    mStorage.mPointer->~T();
+    deallocate(mStorage.mPointer);
+    mStorage.mPointer = 0;
+  }
+#endif
+};
+
+namespace optional_detail {
+
+// The null pointer marks an empty optional; a stateful allocator counts as
+// part of the value.
+template <typename T, typename Alloc>
+struct optional_layout<indirect_optional<T, Alloc> > {
+  static const std::size_t value_bytes = sizeof(indirect_storage<T, Alloc>);
+  static const std::size_t state_bytes = 0;
+  static const bool uses_sentinel = true;
+  static const bool is_trivially_copyable = false;
+};
+
+}  // namespace optional_detail
+
+#endif  // OPTIONALCPP_INDIRECT_OPTIONAL_HPP
@@ -2,133 +2,1260 @@
 #define OPTIONALCPP_OPTIONAL_HPP
 
 #include <algorithm>
+#include <cassert>
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#if __cplusplus >= 202002L && defined(__cpp_impl_three_way_comparison)
+#define OPTIONALCPP_THREE_WAY_COMPARISON
+#include <compare>
+#endif
+#if __cplusplus >= 201103L
+#include <functional>
+#include <type_traits>
+#include <utility>
+#endif
 
+#if __cplusplus >= 201103L
+#define OPTIONALCPP_CONSTEXPR constexpr
+#else
+#define OPTIONALCPP_CONSTEXPR
+#endif
+
+// Instrumentation records events of optionals per value type, see
+// optional_instrumentation.hpp. Constructors that record events cannot be
+// constexpr, so optionals are not usable in constant expressions then.
+#if defined(OPTIONALCPP_INSTRUMENTATION)
+#include "optional_instrumentation.hpp"
+#define OPTIONALCPP_RECORD(T, event) optional_detail::record_event<T>(event)
+#define OPTIONALCPP_INSTRUMENTED_CONSTEXPR
+#else
+#define OPTIONALCPP_RECORD(T, event)
+#define OPTIONALCPP_INSTRUMENTED_CONSTEXPR OPTIONALCPP_CONSTEXPR
+#endif
+
+#if __cplusplus >= 201402L
+#define OPTIONALCPP_CONSTEXPR14 constexpr
+#else
+#define OPTIONALCPP_CONSTEXPR14
+#endif
+
+#define OPTIONALCPP_ACCESS_THROW 0
+#define OPTIONALCPP_ACCESS_TRAP 1
+#define OPTIONALCPP_ACCESS_ASSUME 2
+
+#ifndef OPTIONALCPP_ACCESS_MODE
+#define OPTIONALCPP_ACCESS_MODE OPTIONALCPP_ACCESS_THROW
+#endif
+
+#if !defined(OPTIONALCPP_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && \
+    !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+#define OPTIONALCPP_NO_EXCEPTIONS
+#endif
+
+#if defined(__GNUC__)
+#define OPTIONALCPP_NORETURN_COLD __attribute__((noreturn, noinline, cold))
+#define OPTIONALCPP_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#elif defined(_MSC_VER)
+#define OPTIONALCPP_NORETURN_COLD __declspec(noreturn) __declspec(noinline)
+#define OPTIONALCPP_UNLIKELY(x) (x)
+#else
+#if __cplusplus >= 201103L
+#define OPTIONALCPP_NORETURN_COLD [[noreturn]]
+#else
+#define OPTIONALCPP_NORETURN_COLD
+#endif
+#define OPTIONALCPP_UNLIKELY(x) (x)
+#endif
+
+#if __cplusplus < 201103L
+// Parameter lists of the fixed arity overloads that stand in for variadic
+// templates before C++11. OPTIONALCPP_FOR_EACH_ARITY(MACRO) expands MACRO(N)
+// for every supported number of arguments N.
+#define OPTIONALCPP_TYPENAMES_1 typename A1
+#define OPTIONALCPP_TYPENAMES_2 OPTIONALCPP_TYPENAMES_1, typename A2
+#define OPTIONALCPP_TYPENAMES_3 OPTIONALCPP_TYPENAMES_2, typename A3
+#define OPTIONALCPP_TYPENAMES_4 OPTIONALCPP_TYPENAMES_3, typename A4
+#define OPTIONALCPP_TYPENAMES_5 OPTIONALCPP_TYPENAMES_4, typename A5
+#define OPTIONALCPP_TYPENAMES_6 OPTIONALCPP_TYPENAMES_5, typename A6
+#define OPTIONALCPP_TYPENAMES_7 OPTIONALCPP_TYPENAMES_6, typename A7
+#define OPTIONALCPP_TYPENAMES_8 OPTIONALCPP_TYPENAMES_7, typename A8
+
+#define OPTIONALCPP_PARAMETERS_1 const A1& a1
+#define OPTIONALCPP_PARAMETERS_2 OPTIONALCPP_PARAMETERS_1, const A2& a2
+#define OPTIONALCPP_PARAMETERS_3 OPTIONALCPP_PARAMETERS_2, const A3& a3
+#define OPTIONALCPP_PARAMETERS_4 OPTIONALCPP_PARAMETERS_3, const A4& a4
+#define OPTIONALCPP_PARAMETERS_5 OPTIONALCPP_PARAMETERS_4, const A5& a5
+#define OPTIONALCPP_PARAMETERS_6 OPTIONALCPP_PARAMETERS_5, const A6& a6
+#define OPTIONALCPP_PARAMETERS_7 OPTIONALCPP_PARAMETERS_6, const A7& a7
+#define OPTIONALCPP_PARAMETERS_8 OPTIONALCPP_PARAMETERS_7, const A8& a8
+
+#define OPTIONALCPP_ARGUMENTS_1 a1
+#define OPTIONALCPP_ARGUMENTS_2 OPTIONALCPP_ARGUMENTS_1, a2
+#define OPTIONALCPP_ARGUMENTS_3 OPTIONALCPP_ARGUMENTS_2, a3
+#define OPTIONALCPP_ARGUMENTS_4 OPTIONALCPP_ARGUMENTS_3, a4
+#define OPTIONALCPP_ARGUMENTS_5 OPTIONALCPP_ARGUMENTS_4, a5
+#define OPTIONALCPP_ARGUMENTS_6 OPTIONALCPP_ARGUMENTS_5, a6
+#define OPTIONALCPP_ARGUMENTS_7 OPTIONALCPP_ARGUMENTS_6, a7
+#define OPTIONALCPP_ARGUMENTS_8 OPTIONALCPP_ARGUMENTS_7, a8
+
+#define OPTIONALCPP_FOR_EACH_ARITY(MACRO) \
+  MACRO(1) MACRO(2) MACRO(3) MACRO(4) MACRO(5) MACRO(6) MACRO(7) MACRO(8)
+#endif
+
+#if __cplusplus < 201103L
 union max_align_t {
   long long ll;
   long double ld;
 };
+#endif
+
+template <typename T>
+struct alignment_probe {
+  bool x;
+  T probee;
+};
+
+template <typename T>
+struct alignment_of {
+  static const std::size_t value = sizeof(alignment_probe<T>) - sizeof(T);
+};
+
+template <typename T>
+const std::size_t alignment_of<T>::value;
+
+namespace optional_detail {
+
+template <bool Value>
+struct bool_constant {
+  static const bool value = Value;
+};
+
+template <bool Value>
+const bool bool_constant<Value>::value;
+
+typedef bool_constant<true> true_type;
+typedef bool_constant<false> false_type;
+
+template <bool Condition, typename Then, typename Else>
+struct conditional {
+  typedef Then type;
+};
+
+template <typename Then, typename Else>
+struct conditional<false, Then, Else> {
+  typedef Else type;
+};
+
+template <std::size_t N>
+struct over_aligned {
+  typedef max_align_t type;
+};
+
+#if __cplusplus >= 201103L || defined(__GNUC__)
+#if __cplusplus >= 201103L
+#define OPTIONALCPP_OVER_ALIGNED(N) \
+  template <>                       \
+  struct over_aligned<N> {          \
+    struct alignas(N) type {        \
+      char mDummy;                  \
+    };                              \
+  };
+#else
+#define OPTIONALCPP_OVER_ALIGNED(N)          \
+  template <>                                \
+  struct over_aligned<N> {                   \
+    struct __attribute__((aligned(N))) type { \
+      char mDummy;                           \
+    };                                       \
+  };
+#endif
+
+OPTIONALCPP_OVER_ALIGNED(1)
+OPTIONALCPP_OVER_ALIGNED(2)
+OPTIONALCPP_OVER_ALIGNED(4)
+OPTIONALCPP_OVER_ALIGNED(8)
+OPTIONALCPP_OVER_ALIGNED(16)
+OPTIONALCPP_OVER_ALIGNED(32)
+OPTIONALCPP_OVER_ALIGNED(64)
+OPTIONALCPP_OVER_ALIGNED(128)
+
+#undef OPTIONALCPP_OVER_ALIGNED
+#endif
+
+template <int Index>
+struct alignment_candidate;
+
+#define OPTIONALCPP_ALIGNMENT_CANDIDATE(Index, T) \
+  template <>                                    \
+  struct alignment_candidate<Index> {            \
+    typedef T type;                              \
+  };
+
+OPTIONALCPP_ALIGNMENT_CANDIDATE(0, char)
+OPTIONALCPP_ALIGNMENT_CANDIDATE(1, short)
+OPTIONALCPP_ALIGNMENT_CANDIDATE(2, int)
+OPTIONALCPP_ALIGNMENT_CANDIDATE(3, long)
+OPTIONALCPP_ALIGNMENT_CANDIDATE(4, long long)
+OPTIONALCPP_ALIGNMENT_CANDIDATE(5, float)
+OPTIONALCPP_ALIGNMENT_CANDIDATE(6, double)
+OPTIONALCPP_ALIGNMENT_CANDIDATE(7, long double)
+OPTIONALCPP_ALIGNMENT_CANDIDATE(8, void*)
+
+#undef OPTIONALCPP_ALIGNMENT_CANDIDATE
+
+const int alignment_candidate_count = 9;
+
+template <std::size_t N, int Index = 0>
+struct find_type_with_alignment {
+  typedef typename alignment_candidate<Index>::type candidate;
+  typedef typename conditional<
+      alignment_of<candidate>::value == N, candidate,
+      typename find_type_with_alignment<N, Index + 1>::type>::type type;
+};
+
+template <std::size_t N>
+struct find_type_with_alignment<N, alignment_candidate_count> {
+  typedef typename over_aligned<N>::type type;
+};
+
+}  // namespace optional_detail
+
+template <std::size_t N>
+struct type_with_alignment {
+  typedef typename optional_detail::find_type_with_alignment<N>::type type;
+};
+
+#if __cplusplus >= 201103L
+template <std::size_t Size,
+          std::size_t Alignment = alignment_of<max_align_t>::value>
+struct aligned_storage {
+  alignas(Alignment) char mStorage[Size];
+};
+#else
+template <std::size_t Size,
+          std::size_t Alignment = alignment_of<max_align_t>::value>
+struct aligned_storage {
+  union {
+    char mStorage[Size];
+    typename type_with_alignment<Alignment>::type mAlignmentDummy;
+  };
+};
+#endif
+
+namespace optional_detail {
+
+#if __cplusplus >= 201103L
+using std::swap;
+
+template <typename T>
+struct is_nothrow_swappable {
+  static const bool value =
+      noexcept(swap(std::declval<T&>(), std::declval<T&>()));
+};
+
+template <typename T>
+struct is_arithmetic : bool_constant<std::is_arithmetic<T>::value> {};
+
+template <typename T>
+struct is_scalar : bool_constant<std::is_scalar<T>::value> {};
+
+template <typename T>
+struct is_trivially_copyable
+    : bool_constant<std::is_trivially_copyable<T>::value> {};
+
+template <typename T>
+struct is_trivially_destructible
+    : bool_constant<std::is_trivially_destructible<T>::value> {};
+#else
+template <typename T>
+struct is_arithmetic : false_type {};
+
+template <typename T>
+struct is_arithmetic<const T> : is_arithmetic<T> {};
+
+template <typename T>
+struct is_arithmetic<volatile T> : is_arithmetic<T> {};
+
+template <typename T>
+struct is_arithmetic<const volatile T> : is_arithmetic<T> {};
+
+#define OPTIONALCPP_ARITHMETIC(T) \
+  template <>                     \
+  struct is_arithmetic<T> : true_type {};
+
+OPTIONALCPP_ARITHMETIC(bool)
+OPTIONALCPP_ARITHMETIC(char)
+OPTIONALCPP_ARITHMETIC(signed char)
+OPTIONALCPP_ARITHMETIC(unsigned char)
+OPTIONALCPP_ARITHMETIC(wchar_t)
+OPTIONALCPP_ARITHMETIC(short)
+OPTIONALCPP_ARITHMETIC(unsigned short)
+OPTIONALCPP_ARITHMETIC(int)
+OPTIONALCPP_ARITHMETIC(unsigned int)
+OPTIONALCPP_ARITHMETIC(long)
+OPTIONALCPP_ARITHMETIC(unsigned long)
+OPTIONALCPP_ARITHMETIC(long long)
+OPTIONALCPP_ARITHMETIC(unsigned long long)
+OPTIONALCPP_ARITHMETIC(float)
+OPTIONALCPP_ARITHMETIC(double)
+OPTIONALCPP_ARITHMETIC(long double)
+
+#undef OPTIONALCPP_ARITHMETIC
+
+template <typename T>
+struct is_scalar : is_arithmetic<T> {};
+
+template <typename T>
+struct is_scalar<T*> : true_type {};
+
+template <typename T>
+struct is_scalar<T* const> : true_type {};
+
+template <typename T>
+struct is_scalar<T* volatile> : true_type {};
+
+template <typename T>
+struct is_scalar<T* const volatile> : true_type {};
+
+template <typename T>
+struct is_trivially_copyable : is_scalar<T> {};
+
+template <typename T>
+struct is_trivially_destructible : is_scalar<T> {};
+
+template <typename T>
+struct is_default_constructible {
+  typedef char yes;
+  typedef char (&no)[2];
+
+  template <typename U>
+  static yes test(char (*)[sizeof((U()))]);
+
+  template <typename U>
+  static no test(...);
+
+  static const bool value = sizeof(test<T>(0)) == sizeof(yes);
+};
+#endif
+
+struct relocate_by_memcpy {};
+struct relocate_by_move {};
+struct relocate_by_swap {};
+struct relocate_by_copy {};
+
+}  // namespace optional_detail
+
+class bad_optional_access : public std::exception {};
+
+#if defined(OPTIONALCPP_NO_EXCEPTIONS)
+typedef void (*bad_optional_access_handler)();
+
+namespace optional_detail {
+
+inline bad_optional_access_handler& installed_bad_access_handler() {
+  static bad_optional_access_handler handler = 0;
+  return handler;
+}
+
+}  // namespace optional_detail
+
+inline bad_optional_access_handler set_bad_optional_access_handler(
+    bad_optional_access_handler handler) {
+  bad_optional_access_handler& installed =
+      optional_detail::installed_bad_access_handler();
+  const bad_optional_access_handler previous = installed;
+  installed = handler;
+  return previous;
+}
+
+inline bad_optional_access_handler get_bad_optional_access_handler() {
+  return optional_detail::installed_bad_access_handler();
+}
+#endif
+
+namespace optional_detail {
+
+OPTIONALCPP_NORETURN_COLD inline void report_bad_access() {
+#if defined(OPTIONALCPP_NO_EXCEPTIONS)
+  const bad_optional_access_handler handler = installed_bad_access_handler();
+  if (handler != 0) {
+    handler();
+  }
+  std::abort();
+#else
+  throw bad_optional_access();
+#endif
+}
+
+inline void check_access(bool hasValue) {
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_TRAP
+  assert(hasValue && "access to an empty optional");
+  if (not hasValue) {
+#if defined(__GNUC__)
+    __builtin_trap();
+#else
+    std::abort();
+#endif
+  }
+#elif OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_ASSUME
+#if defined(__clang__)
+  __builtin_assume(hasValue);
+#elif defined(__GNUC__)
+  if (not hasValue) {
+    __builtin_unreachable();
+  }
+#elif defined(_MSC_VER)
+  __assume(hasValue);
+#endif
+#else
+  if (OPTIONALCPP_UNLIKELY(not hasValue)) {
+    report_bad_access();
+  }
+#endif
+}
+
+}  // namespace optional_detail
+
+struct nullopt_t {};
+
+const nullopt_t nullopt;
+
+struct in_place_t {};
+
+const in_place_t in_place;
+
+template <typename T>
+struct is_trivially_relocatable : optional_detail::is_trivially_copyable<T> {};
+
+namespace optional_detail {
+
+template <typename T>
+struct relocation_strategy {
+#if __cplusplus >= 201103L
+  typedef typename conditional<is_trivially_relocatable<T>::value,
+                               relocate_by_memcpy, relocate_by_move>::type type;
+#else
+  typedef typename conditional<
+      is_trivially_relocatable<T>::value, relocate_by_memcpy,
+      typename conditional<is_default_constructible<T>::value,
+                           relocate_by_swap, relocate_by_copy>::type>::type
+      type;
+#endif
+};
+
+template <typename T>
+struct holds_value_when_empty : is_arithmetic<T> {};
+
+#if __cplusplus >= 201103L
+struct from_invocation_t {};
+
+template <typename F, typename Arg, typename = void>
+struct invoke_result {};
+
+template <typename F, typename Arg>
+struct invoke_result<F, Arg,
+                     decltype(void(std::declval<F>()(std::declval<Arg>())))> {
+  typedef typename std::decay<decltype(
+      std::declval<F>()(std::declval<Arg>()))>::type type;
+};
+
+template <typename T, bool = std::is_trivially_destructible<T>::value>
+union optional_union {
+  constexpr explicit optional_union(false_type)
+      : mEmpty() {}
+
+  constexpr explicit optional_union(true_type)
+      : mValue() {}
+
+  template <typename... Args>
+  constexpr explicit optional_union(in_place_t, Args&&... args)
+      : mValue(std::forward<Args>(args)...) {}
+
+  template <typename F, typename Arg>
+  constexpr optional_union(from_invocation_t, F&& f, Arg&& arg)
+      : mValue(std::forward<F>(f)(std::forward<Arg>(arg))) {}
+
+  char mEmpty;
+  T mValue;
+};
+
+template <typename T>
+union optional_union<T, false> {
+  constexpr explicit optional_union(false_type)
+      : mEmpty() {}
+
+  constexpr explicit optional_union(true_type)
+      : mValue() {}
+
+  template <typename... Args>
+  constexpr explicit optional_union(in_place_t, Args&&... args)
+      : mValue(std::forward<Args>(args)...) {}
+
+  template <typename F, typename Arg>
+  constexpr optional_union(from_invocation_t, F&& f, Arg&& arg)
+      : mValue(std::forward<F>(f)(std::forward<Arg>(arg))) {}
+
+  ~optional_union() {}
+
+  char mEmpty;
+  T mValue;
+};
+#endif
+
+template <typename T>
+class optional_value_storage {
+ protected:
+#if __cplusplus >= 201103L
+  constexpr optional_value_storage()
+      : mBuffer(bool_constant<holds_value_when_empty<T>::value>())
+      , mHasValue(false) {}
+
+  template <typename... Args>
+  constexpr explicit optional_value_storage(in_place_t, Args&&... args)
+      : mBuffer(in_place, std::forward<Args>(args)...)
+      , mHasValue(true) {}
+
+  template <typename F, typename Arg>
+  constexpr optional_value_storage(from_invocation_t, F&& f, Arg&& arg)
+      : mBuffer(from_invocation_t(), std::forward<F>(f),
+                std::forward<Arg>(arg))
+      , mHasValue(true) {}
+
+  optional_union<T> mBuffer;
+
+  bool mHasValue;
+
+  constexpr const T& storedValue() const {
+    return mBuffer.mValue;
+  }
+
+  OPTIONALCPP_CONSTEXPR14 T& storedValue() {
+    return mBuffer.mValue;
+  }
+#else
+  optional_value_storage()
+      : mHasValue(false) {
+    initializeEmptyValue(bool_constant<holds_value_when_empty<T>::value>());
+  }
+
+  aligned_storage<sizeof(T), alignment_of<T>::value> mBuffer;
+
+  bool mHasValue;
+
+  const T& storedValue() const {
+    return *reinterpret_cast<const T*>(&mBuffer);
+  }
+
+  T& storedValue() {
+    return *reinterpret_cast<T*>(&mBuffer);
+  }
+
+  void initializeEmptyValue(true_type) {
+    new (static_cast<void*>(&mBuffer)) T();
+  }
+
+  void initializeEmptyValue(false_type) {}
+#endif
+
+#if __cplusplus >= 201103L
+  template <typename... Args>
+  void constructValue(Args&&... args) {
+    new (static_cast<void*>(&mBuffer)) T(std::forward<Args>(args)...);
+    mHasValue = true;
+    OPTIONALCPP_RECORD(T, optional_construction);
+  }
+#else
+  void constructValue() {
+    new (static_cast<void*>(&mBuffer)) T();
+    mHasValue = true;
+    OPTIONALCPP_RECORD(T, optional_construction);
+  }
+
+#define OPTIONALCPP_CONSTRUCT_VALUE(N)                               \
+  template <OPTIONALCPP_TYPENAMES_##N>                               \
+  void constructValue(OPTIONALCPP_PARAMETERS_##N) {                  \
+    new (static_cast<void*>(&mBuffer)) T(OPTIONALCPP_ARGUMENTS_##N); \
+    mHasValue = true;                                                \
+    OPTIONALCPP_RECORD(T, optional_construction);                    \
+  }
+
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_CONSTRUCT_VALUE)
+
+#undef OPTIONALCPP_CONSTRUCT_VALUE
+#endif
+
+  void destructValue() {
+    destroyValue(is_trivially_destructible<T>());
+    mHasValue = false;
+    OPTIONALCPP_RECORD(T, optional_destruction);
+  }
+
+  void destroyValue(true_type) {}
+
+  void destroyValue(false_type) {
+    storedValue().~T();
+  }
+};
+
+// Whether optional<T> has trivial special members. Instrumented optionals
+// give them up so that copies and destructions of every payload are counted.
+#if defined(OPTIONALCPP_INSTRUMENTATION)
+template <typename T>
+struct has_trivial_destructor : false_type {};
+
+template <typename T>
+struct has_trivial_copy : false_type {};
+#else
+template <typename T>
+struct has_trivial_destructor : is_trivially_destructible<T> {};
+
+template <typename T>
+struct has_trivial_copy : is_trivially_copyable<T> {};
+#endif
+
+template <typename T, bool = has_trivial_destructor<T>::value>
+class optional_destruct_base : public optional_value_storage<T> {
+#if __cplusplus >= 201103L
+ protected:
+  using optional_value_storage<T>::optional_value_storage;
+#endif
+};
+
+template <typename T>
+class optional_destruct_base<T, false> : public optional_value_storage<T> {
+ protected:
+#if __cplusplus >= 201103L
+  using optional_value_storage<T>::optional_value_storage;
+#endif
+
+  OPTIONALCPP_CONSTEXPR optional_destruct_base() {}
+
+  ~optional_destruct_base() {
+    if (this->mHasValue) {
+      this->destructValue();
+    }
+  }
+};
+
+template <typename T, bool = has_trivial_copy<T>::value>
+class optional_copy_base : public optional_destruct_base<T> {
+#if __cplusplus >= 201103L
+ protected:
+  using optional_destruct_base<T>::optional_destruct_base;
+#endif
+};
+
+template <typename T>
+class optional_copy_base<T, false> : public optional_destruct_base<T> {
+ protected:
+#if __cplusplus >= 201103L
+  using optional_destruct_base<T>::optional_destruct_base;
+#endif
+
+  OPTIONALCPP_CONSTEXPR optional_copy_base() {}
+
+  optional_copy_base(const optional_copy_base& other) {
+    if (other.mHasValue) {
+      OPTIONALCPP_RECORD(T, optional_copy);
+      this->constructValue(other.storedValue());
+    }
+  }
+
+#if __cplusplus >= 201103L
+  optional_copy_base(optional_copy_base&& other) noexcept(
+      std::is_nothrow_move_constructible<T>::value) {
+    if (other.mHasValue) {
+      OPTIONALCPP_RECORD(T, optional_move);
+      this->constructValue(std::move(other.storedValue()));
+    }
+  }
+#endif
+
+  optional_copy_base& operator=(const optional_copy_base& other) {
+    if (other.mHasValue) {
+      OPTIONALCPP_RECORD(T, optional_copy);
+    }
+    if (this->mHasValue && other.mHasValue) {
+      this->storedValue() = other.storedValue();
+    } else if (other.mHasValue) {
+      this->constructValue(other.storedValue());
+    } else if (this->mHasValue) {
+      this->destructValue();
+    }
+    return *this;
+  }
+
+#if __cplusplus >= 201103L
+  optional_copy_base& operator=(optional_copy_base&& other) noexcept(
+      std::is_nothrow_move_constructible<T>::value &&
+      std::is_nothrow_move_assignable<T>::value) {
+    if (other.mHasValue) {
+      OPTIONALCPP_RECORD(T, optional_move);
+    }
+    if (this->mHasValue && other.mHasValue) {
+      this->storedValue() = std::move(other.storedValue());
+    } else if (other.mHasValue) {
+      this->constructValue(std::move(other.storedValue()));
+    } else if (this->mHasValue) {
+      this->destructValue();
+    }
+    return *this;
+  }
+#endif
+};
+
+}  // namespace optional_detail
+
+template <typename T>
+class optional;
+
+namespace optional_detail {
+
+template <typename Optional>
+struct branchless_comparable : is_arithmetic<typename Optional::value_type> {};
+
+template <typename T>
+struct branchless_comparable<optional<T&> > : false_type {};
+
+template <typename Optional>
+class comparison_operators;
+
+struct optional_like_detector {
+  typedef char yes;
+  typedef char (&no)[2];
+
+  template <typename Optional>
+  static yes test(const comparison_operators<Optional>*);
+
+  static no test(...);
+};
+
+template <typename T>
+struct is_optional_like
+    : bool_constant<sizeof(optional_like_detector::test(
+                        static_cast<const T*>(0))) ==
+                    sizeof(optional_like_detector::yes)> {};
+
+template <bool Condition, typename T = void>
+struct enable_if {};
+
+template <typename T>
+struct enable_if<true, T> {
+  typedef T type;
+};
+
+template <typename U>
+struct value_comparison : enable_if<not is_optional_like<U>::value, bool> {};
+
+template <typename U>
+struct optional_comparison : enable_if<is_optional_like<U>::value, bool> {};
+
+#if __cplusplus >= 201103L
+// Whether a U is assigned directly to the value of an optional<T>. As in
+// std::optional, scalars of the value type itself are left to the converting
+// constructor, which costs nothing extra for them.
+template <typename T, typename U>
+struct value_assignment
+    : bool_constant<not is_optional_like<typename std::decay<U>::type>::value &&
+                    not std::is_same<typename std::decay<U>::type,
+                                     nullopt_t>::value &&
+                    not(std::is_scalar<T>::value &&
+                        std::is_same<typename std::decay<U>::type, T>::value) &&
+                    std::is_constructible<T, U>::value &&
+                    std::is_assignable<T&, U>::value> {};
+#endif
+
+#if defined(OPTIONALCPP_THREE_WAY_COMPARISON)
+template <typename Self, typename Optional, typename U>
+concept compared_with_value =
+    std::is_base_of_v<Optional, Self> && (not is_optional_like<U>::value) &&
+    (not std::is_same_v<U, nullopt_t>);
+
+template <typename Self, typename Optional, typename Other>
+concept compared_with_optional =
+    std::is_base_of_v<Optional, Self> && is_optional_like<Other>::value;
+
+template <typename Self, typename Optional, typename U>
+concept three_way_comparable_value =
+    compared_with_value<Self, Optional, U> &&
+    std::three_way_comparable_with<typename Self::value_type, U>;
+
+template <typename Self, typename Optional, typename U>
+concept less_than_comparable_value =
+    compared_with_value<Self, Optional, U> &&
+    (not std::three_way_comparable_with<typename Self::value_type, U>);
+
+template <typename T, typename U>
+constexpr auto synth_three_way(const T& a, const U& b) {
+  if constexpr (std::three_way_comparable_with<T, U>) {
+    return a <=> b;
+  } else {
+    return a < b   ? std::weak_ordering::less
+           : b < a ? std::weak_ordering::greater
+                   : std::weak_ordering::equivalent;
+  }
+}
+
+template <typename T>
+using synth_three_way_result = decltype(synth_three_way(
+    std::declval<const T&>(), std::declval<const T&>()));
+#endif
+
+template <typename Optional>
+class comparison_operators {
+ public:
+#if defined(OPTIONALCPP_THREE_WAY_COMPARISON)
+  friend constexpr bool operator==(const Optional& a, const Optional& b) {
+    return equal(a, b, branchless_comparable<Optional>());
+  }
+
+  template <typename Self, typename U>
+    requires compared_with_value<Self, Optional, U>
+  friend constexpr bool operator==(const Self& a, const U& b) {
+    return a.has_value() && *a == b;
+  }
+
+  template <typename Self, typename Other>
+    requires compared_with_optional<Self, Optional, Other>
+  friend constexpr bool operator==(const Self& a, const Other& b) {
+    return a.has_value() && b.has_value() ? *a == *b
+                                          : a.has_value() == b.has_value();
+  }
+
+  friend constexpr bool operator==(const Optional& a, nullopt_t) {
+    return not a.has_value();
+  }
+
+  friend constexpr auto operator<=>(const Optional& a, const Optional& b) {
+    typedef synth_three_way_result<typename Optional::value_type> ordering;
+    return a.has_value() && b.has_value()
+               ? ordering(synth_three_way(*a, *b))
+               : ordering(a.has_value() <=> b.has_value());
+  }
+
+  template <typename Self, typename Other>
+    requires compared_with_optional<Self, Optional, Other>
+  friend constexpr auto operator<=>(const Self& a, const Other& b) {
+    typedef decltype(synth_three_way(*a, *b)) ordering;
+    return a.has_value() && b.has_value()
+               ? ordering(synth_three_way(*a, *b))
+               : ordering(a.has_value() <=> b.has_value());
+  }
+
+  template <typename Self, typename U>
+    requires three_way_comparable_value<Self, Optional, U>
+  friend constexpr auto operator<=>(const Self& a, const U& b) {
+    typedef std::compare_three_way_result_t<typename Self::value_type, U>
+        ordering;
+    return a.has_value() ? ordering(*a <=> b)
+                         : ordering(std::strong_ordering::less);
+  }
+
+  friend constexpr std::strong_ordering operator<=>(const Optional& a,
+                                                    nullopt_t) {
+    return a.has_value() <=> false;
+  }
+
+  // a < b would otherwise be rewritten through operator<=>, which branches on
+  // has_value(), so arithmetic values keep the branchless kernels.
+  friend constexpr bool operator<(const Optional& a, const Optional& b)
+    requires branchless_comparable<Optional>::value
+  {
+    return less(a, b, true_type());
+  }
+
+  friend constexpr bool operator>(const Optional& a, const Optional& b)
+    requires branchless_comparable<Optional>::value
+  {
+    return less(b, a, true_type());
+  }
+
+  friend constexpr bool operator<=(const Optional& a, const Optional& b)
+    requires branchless_comparable<Optional>::value
+  {
+    return less_equal(a, b);
+  }
+
+  friend constexpr bool operator>=(const Optional& a, const Optional& b)
+    requires branchless_comparable<Optional>::value
+  {
+    return less_equal(b, a);
+  }
+
+  template <typename Self, typename U>
+    requires less_than_comparable_value<Self, Optional, U>
+  friend constexpr bool operator<(const Self& a, const U& b) {
+    return not a.has_value() || *a < b;
+  }
+
+  template <typename U, typename Self>
+    requires less_than_comparable_value<Self, Optional, U>
+  friend constexpr bool operator<(const U& a, const Self& b) {
+    return b.has_value() && a < *b;
+  }
+
+  template <typename Self, typename U>
+    requires less_than_comparable_value<Self, Optional, U>
+  friend constexpr bool operator>(const Self& a, const U& b) {
+    return b < a;
+  }
+
+  template <typename U, typename Self>
+    requires less_than_comparable_value<Self, Optional, U>
+  friend constexpr bool operator>(const U& a, const Self& b) {
+    return b < a;
+  }
+
+  template <typename Self, typename U>
+    requires less_than_comparable_value<Self, Optional, U>
+  friend constexpr bool operator>=(const Self& a, const U& b) {
+    return !(a < b);
+  }
+
+  template <typename U, typename Self>
+    requires less_than_comparable_value<Self, Optional, U>
+  friend constexpr bool operator>=(const U& a, const Self& b) {
+    return !(a < b);
+  }
+
+  template <typename Self, typename U>
+    requires less_than_comparable_value<Self, Optional, U>
+  friend constexpr bool operator<=(const Self& a, const U& b) {
+    return !(b < a);
+  }
+
+  template <typename U, typename Self>
+    requires less_than_comparable_value<Self, Optional, U>
+  friend constexpr bool operator<=(const U& a, const Self& b) {
+    return !(b < a);
+  }
+#else
+  friend OPTIONALCPP_CONSTEXPR bool operator==(const Optional& a,
+                                               const Optional& b) {
+    return equal(a, b, branchless_comparable<Optional>());
+  }
 
-template <typename T>
-struct alignment_probe {
-  bool x;
-  T probee;
-};
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator==(
+      const Optional& a, const U& b) {
+    return a.has_value() && *a == b;
+  }
 
-template <typename T>
-struct alignment_of {
-  static const std::size_t value = sizeof(alignment_probe<T>) - sizeof(T);
-};
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator==(
+      const U& a, const Optional& b) {
+    return b == a;
+  }
 
-template <std::size_t N>
-struct type_with_alignment {
-  typedef max_align_t type;
-};
+  friend OPTIONALCPP_CONSTEXPR bool operator==(nullopt_t, const Optional& b) {
+    return not b.has_value();
+  }
 
-template <>
-struct type_with_alignment<alignment_of<char>::value> {
-  typedef char type;
-};
+  friend OPTIONALCPP_CONSTEXPR bool operator==(const Optional& a, nullopt_t) {
+    return nullopt == a;
+  }
 
-template <>
-struct type_with_alignment<alignment_of<short>::value> {
-  typedef short type;
-};
+  friend OPTIONALCPP_CONSTEXPR bool operator!=(const Optional& a,
+                                               const Optional& b) {
+    return !(a == b);
+  }
 
-template <>
-struct type_with_alignment<alignment_of<int>::value> {
-  typedef int type;
-};
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator!=(
+      const Optional& a, const U& b) {
+    return !(a == b);
+  }
 
-template <>
-struct type_with_alignment<alignment_of<long>::value> {
-  typedef long type;
-};
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator!=(
+      const U& a, const Optional& b) {
+    return !(a == b);
+  }
 
-template <std::size_t Size,
-          std::size_t Alignment = alignment_of<max_align_t>::value>
-struct aligned_storage {
-  union {
-    char mStorage[Size];
-    typename type_with_alignment<Alignment>::type mAlignmentDummy;
-  };
-};
+  friend OPTIONALCPP_CONSTEXPR bool operator<(const Optional& a,
+                                              const Optional& b) {
+    return less(a, b, branchless_comparable<Optional>());
+  }
 
-class bad_optional_access : public std::exception {};
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator<(
+      const Optional& a, const U& b) {
+    return not a.has_value() || *a < b;
+  }
 
-struct nullopt_t {};
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator<(
+      const U& a, const Optional& b) {
+    return b.has_value() && a < *b;
+  }
 
-const nullopt_t nullopt;
+  friend OPTIONALCPP_CONSTEXPR bool operator<(nullopt_t, const Optional& b) {
+    return b.has_value();
+  }
+
+  friend OPTIONALCPP_CONSTEXPR bool operator<(const Optional&, nullopt_t) {
+    return false;
+  }
+
+  friend OPTIONALCPP_CONSTEXPR bool operator>(const Optional& a,
+                                              const Optional& b) {
+    return b < a;
+  }
+
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator>(
+      const Optional& a, const U& b) {
+    return b < a;
+  }
+
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator>(
+      const U& a, const Optional& b) {
+    return b < a;
+  }
+
+  friend OPTIONALCPP_CONSTEXPR bool operator>=(const Optional& a,
+                                               const Optional& b) {
+    return !(a < b);
+  }
+
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator>=(
+      const Optional& a, const U& b) {
+    return !(a < b);
+  }
+
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator>=(
+      const U& a, const Optional& b) {
+    return !(a < b);
+  }
+
+  friend OPTIONALCPP_CONSTEXPR bool operator<=(const Optional& a,
+                                               const Optional& b) {
+    return !(b < a);
+  }
+
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator<=(
+      const Optional& a, const U& b) {
+    return !(b < a);
+  }
+
+  template <typename U>
+  friend OPTIONALCPP_CONSTEXPR typename value_comparison<U>::type operator<=(
+      const U& a, const Optional& b) {
+    return !(b < a);
+  }
+
+  template <typename Other>
+  friend OPTIONALCPP_CONSTEXPR typename optional_comparison<Other>::type
+  operator==(const Optional& a, const Other& b) {
+    return a.has_value() && b.has_value() ? *a == *b
+                                          : a.has_value() == b.has_value();
+  }
+
+  template <typename Other>
+  friend OPTIONALCPP_CONSTEXPR typename optional_comparison<Other>::type
+  operator!=(const Optional& a, const Other& b) {
+    return !(a == b);
+  }
+
+  template <typename Other>
+  friend OPTIONALCPP_CONSTEXPR typename optional_comparison<Other>::type
+  operator<(const Optional& a, const Other& b) {
+    return b.has_value() && (not a.has_value() || *a < *b);
+  }
+
+  template <typename Other>
+  friend OPTIONALCPP_CONSTEXPR typename optional_comparison<Other>::type
+  operator>(const Optional& a, const Other& b) {
+    return b < a;
+  }
+
+  template <typename Other>
+  friend OPTIONALCPP_CONSTEXPR typename optional_comparison<Other>::type
+  operator>=(const Optional& a, const Other& b) {
+    return !(a < b);
+  }
+
+  template <typename Other>
+  friend OPTIONALCPP_CONSTEXPR typename optional_comparison<Other>::type
+  operator<=(const Optional& a, const Other& b) {
+    return !(b < a);
+  }
+#endif
+
+ private:
+  static OPTIONALCPP_CONSTEXPR bool equal(const Optional& a, const Optional& b,
+                                          false_type) {
+    return a.has_value() && b.has_value() ? *a == *b
+                                          : a.has_value() == b.has_value();
+  }
+
+  static OPTIONALCPP_CONSTEXPR bool equal(const Optional& a, const Optional& b,
+                                          true_type) {
+    return (a.has_value() == b.has_value()) &
+           (not a.has_value() | (*a == *b));
+  }
+
+  static OPTIONALCPP_CONSTEXPR bool less(const Optional& a, const Optional& b,
+                                         false_type) {
+    return b.has_value() && (not a.has_value() || *a < *b);
+  }
+
+  static OPTIONALCPP_CONSTEXPR bool less(const Optional& a, const Optional& b,
+                                         true_type) {
+    return b.has_value() & (not a.has_value() | (*a < *b));
+  }
+
+#if defined(OPTIONALCPP_THREE_WAY_COMPARISON)
+  // Not !less(b, a), which would be true for NaN.
+  static constexpr bool less_equal(const Optional& a, const Optional& b) {
+    return not a.has_value() | (b.has_value() & (*a <= *b));
+  }
+#endif
+};
+
+}  // namespace optional_detail
 
 template <typename T>
-class optional {
+class optional : private optional_detail::optional_copy_base<T>,
+                 public optional_detail::comparison_operators<optional<T> > {
+  typedef optional_detail::optional_copy_base<T> storage_base;
+
  public:
-  optional()
-      : mHasValue(false) {}
+  typedef T value_type;
+
+  OPTIONALCPP_CONSTEXPR optional() {}
+
+  OPTIONALCPP_CONSTEXPR optional(nullopt_t) {}
+
+#if __cplusplus >= 201103L
+  OPTIONALCPP_INSTRUMENTED_CONSTEXPR optional(const T& value)
+      : storage_base(in_place, value) {
+    OPTIONALCPP_RECORD(T, optional_construction);
+  }
 
-  optional(nullopt_t)
-      : mHasValue(false) {}
+  OPTIONALCPP_INSTRUMENTED_CONSTEXPR optional(T&& value)
+      : storage_base(in_place, std::move(value)) {
+    OPTIONALCPP_RECORD(T, optional_construction);
+  }
 
+  template <typename... Args>
+  OPTIONALCPP_INSTRUMENTED_CONSTEXPR explicit optional(in_place_t,
+                                                       Args&&... args)
+      : storage_base(in_place, std::forward<Args>(args)...) {
+    OPTIONALCPP_RECORD(T, optional_construction);
+  }
+#else
   optional(const T& value) {
     constructValue(value);
   }
 
-  optional(const optional& other)
-      : mHasValue(other.mHasValue) {
-    if (other.mHasValue) {
-      constructValue(*other);
-    }
+  explicit optional(in_place_t) {
+    constructValue();
   }
 
-  optional& operator=(const optional& other) {
-    if (mHasValue && other.mHasValue) {
-      *(*this) = *other;
-    } else if (other.mHasValue) {
-      constructValue(*other);
-    } else if (mHasValue) {
-      destructValue();
-    }
-    return *this;
+#define OPTIONALCPP_IN_PLACE_CONSTRUCTOR(N)                   \
+  template <OPTIONALCPP_TYPENAMES_##N>                        \
+  explicit optional(in_place_t, OPTIONALCPP_PARAMETERS_##N) { \
+    constructValue(OPTIONALCPP_ARGUMENTS_##N);                \
   }
 
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_IN_PLACE_CONSTRUCTOR)
+
+#undef OPTIONALCPP_IN_PLACE_CONSTRUCTOR
+#endif
+
   optional& operator=(nullopt_t) {
     reset();
     return *this;
   }
 
-  ~optional() {
+  // Assigns to the contained value instead of going through a temporary
+  // optional.
+#if __cplusplus >= 201103L
+  template <typename U = T,
+            typename = typename std::enable_if<
+                optional_detail::value_assignment<T, U>::value>::type>
+  optional& operator=(U&& value) {
     if (mHasValue) {
-      destructValue();
+      this->storedValue() = std::forward<U>(value);
+    } else {
+      constructValue(std::forward<U>(value));
+    }
+    return *this;
+  }
+#else
+  template <typename U>
+  typename optional_detail::enable_if<
+      not optional_detail::is_optional_like<U>::value, optional&>::type
+  operator=(const U& value) {
+    if (mHasValue) {
+      this->storedValue() = value;
+    } else {
+      constructValue(value);
     }
+    return *this;
   }
+#endif
 
-  bool has_value() const {
+  OPTIONALCPP_CONSTEXPR bool has_value() const {
     return mHasValue;
   }
 
-  operator bool() const {
+  OPTIONALCPP_CONSTEXPR operator bool() const {
     return mHasValue;
   }
 
   const T& value() const {
-    throwInCaseOfBadAccess();
+    checkAccess();
     return *(*this);
   }
 
   T& value() {
-    throwInCaseOfBadAccess();
+    checkAccess();
     return *(*this);
   }
 
-  const T& operator*() const {
-    return *reinterpret_cast<const T*>(&mBuffer);
+  OPTIONALCPP_CONSTEXPR const T& operator*() const {
+    return this->storedValue();
   }
 
-  T& operator*() {
-    return *reinterpret_cast<T*>(&mBuffer);
+  OPTIONALCPP_CONSTEXPR14 T& operator*() {
+    return this->storedValue();
+  }
+
+#if __cplusplus >= 201103L
+  constexpr const T& value_or(const T& defaultValue) const& {
+    return mHasValue ? this->storedValue() : defaultValue;
+  }
+
+  template <typename U, typename = typename std::enable_if<not(
+                            std::is_lvalue_reference<U>::value &&
+                            std::is_same<typename std::decay<U>::type,
+                                         T>::value)>::type>
+  constexpr T value_or(U&& defaultValue) const& {
+    return mHasValue ? this->storedValue()
+                     : static_cast<T>(static_cast<U&&>(defaultValue));
   }
 
-  const T* operator->() const {
+  template <typename U>
+  OPTIONALCPP_CONSTEXPR14 T value_or(U&& defaultValue) && {
+    return mHasValue ? std::move(this->storedValue())
+                     : static_cast<T>(static_cast<U&&>(defaultValue));
+  }
+#else
+  template <typename U>
+  T value_or(const U& defaultValue) const {
+    return mHasValue ? this->storedValue() : static_cast<T>(defaultValue);
+  }
+#endif
+
+  OPTIONALCPP_CONSTEXPR const T* operator->() const {
     return &(*(*this));
   }
 
@@ -136,16 +1263,89 @@ class optional {
     return &(*(*this));
   }
 
+#if __cplusplus >= 201103L
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14 typename optional_detail::invoke_result<F, T&>::type
+  and_then(F&& f) & {
+    typedef typename optional_detail::invoke_result<F, T&>::type result;
+    return mHasValue ? std::forward<F>(f)(this->storedValue()) : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14
+      typename optional_detail::invoke_result<F, const T&>::type
+      and_then(F&& f) const& {
+    typedef typename optional_detail::invoke_result<F, const T&>::type result;
+    return mHasValue ? std::forward<F>(f)(this->storedValue()) : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14 typename optional_detail::invoke_result<F, T&&>::type
+  and_then(F&& f) && {
+    typedef typename optional_detail::invoke_result<F, T&&>::type result;
+    return mHasValue ? std::forward<F>(f)(std::move(this->storedValue()))
+                     : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14
+      optional<typename optional_detail::invoke_result<F, T&>::type>
+      transform(F&& f) & {
+    typedef optional<typename optional_detail::invoke_result<F, T&>::type>
+        result;
+    return mHasValue ? result(optional_detail::from_invocation_t(),
+                              std::forward<F>(f), this->storedValue())
+                     : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14
+      optional<typename optional_detail::invoke_result<F, const T&>::type>
+      transform(F&& f) const& {
+    typedef optional<
+        typename optional_detail::invoke_result<F, const T&>::type>
+        result;
+    return mHasValue ? result(optional_detail::from_invocation_t(),
+                              std::forward<F>(f), this->storedValue())
+                     : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14
+      optional<typename optional_detail::invoke_result<F, T&&>::type>
+      transform(F&& f) && {
+    typedef optional<typename optional_detail::invoke_result<F, T&&>::type>
+        result;
+    return mHasValue
+               ? result(optional_detail::from_invocation_t(),
+                        std::forward<F>(f), std::move(this->storedValue()))
+               : result();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14 optional or_else(F&& f) const& {
+    return mHasValue ? *this : std::forward<F>(f)();
+  }
+
+  template <typename F>
+  OPTIONALCPP_CONSTEXPR14 optional or_else(F&& f) && {
+    return mHasValue ? std::move(*this) : std::forward<F>(f)();
+  }
+
+  void swap(optional& other) noexcept(
+      std::is_nothrow_move_constructible<T>::value &&
+      optional_detail::is_nothrow_swappable<T>::value) {
+#else
   void swap(optional& other) {
+#endif
+    OPTIONALCPP_RECORD(T, optional_swap);
     if (this->has_value() and other.has_value()) {
       using std::swap;
       swap(*(*this), *other);
     } else if (this->has_value()) {
-      other.constructValue(*(*this));
-      this->destructValue();
+      this->relocateValueTo(other);
     } else if (other.has_value()) {
-      this->constructValue(*other);
-      other.destructValue();
+      other.relocateValueTo(*this);
     }
   }
 
@@ -155,119 +1355,164 @@ class optional {
     }
   }
 
-  friend bool operator==(const optional& a, const optional& b) {
-    if (a.mHasValue && b.mHasValue) {
-      return *a == *b;
-    }
-    return !a.mHasValue && !b.mHasValue;
+#if __cplusplus >= 201103L
+  template <typename... Args>
+  T& emplace(Args&&... args) {
+    reset();
+    constructValue(std::forward<Args>(args)...);
+    return *(*this);
   }
-
-  template <typename U>
-  friend bool operator==(const optional& a, const U& b) {
-    if (not a.mHasValue) {
-      return false;
-    }
-    return *a == b;
+#else
+  T& emplace() {
+    reset();
+    constructValue();
+    return *(*this);
   }
 
-  template <typename U>
-  friend bool operator==(const U& a, const optional& b) {
-    return b == a;
+#define OPTIONALCPP_EMPLACE(N)                 \
+  template <OPTIONALCPP_TYPENAMES_##N>         \
+  T& emplace(OPTIONALCPP_PARAMETERS_##N) {     \
+    reset();                                   \
+    constructValue(OPTIONALCPP_ARGUMENTS_##N); \
+    return *(*this);                           \
   }
 
-  friend bool operator==(nullopt_t, const optional& b) {
-     return not b.mHasValue;
-  }
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_EMPLACE)
 
-  friend bool operator==(const optional& a, nullopt_t) {
-     return nullopt == a;
-  }
+#undef OPTIONALCPP_EMPLACE
+#endif
 
-  friend bool operator!=(const optional& a, const optional& b) {
-    return !(a == b);
+#if __cplusplus >= 201103L
+  friend void swap(optional& a, optional& b) noexcept(noexcept(a.swap(b))) {
+    a.swap(b);
   }
-
-  template <typename U>
-  friend bool operator!=(const optional& a, const U& b) {
-    return !(a == b);
+#else
+  friend void swap(optional& a, optional& b) {
+    a.swap(b);
   }
+#endif
 
+ private:
+#if __cplusplus >= 201103L
   template <typename U>
-  friend bool operator!=(const U& a, const optional& b) {
-    return !(a == b);
+  friend class optional;
+
+  template <typename F, typename Arg>
+  OPTIONALCPP_INSTRUMENTED_CONSTEXPR optional(
+      optional_detail::from_invocation_t, F&& f, Arg&& arg)
+      : storage_base(optional_detail::from_invocation_t(), std::forward<F>(f),
+                     std::forward<Arg>(arg)) {
+    OPTIONALCPP_RECORD(T, optional_construction);
   }
+#endif
 
-  friend bool operator<(const optional& a, const optional& b) {
-    if (a.mHasValue && b.mHasValue) {
-      return *a < *b;
+  using optional_detail::optional_value_storage<T>::mHasValue;
+  using optional_detail::optional_value_storage<T>::mBuffer;
+  using optional_detail::optional_value_storage<T>::constructValue;
+  using optional_detail::optional_value_storage<T>::destructValue;
+
+  void checkAccess() const {
+#if defined(OPTIONALCPP_INSTRUMENTATION)
+    if (not mHasValue) {
+      OPTIONALCPP_RECORD(T, optional_bad_access);
     }
-    return !a.mHasValue && b.mHasValue;
+#endif
+    optional_detail::check_access(mHasValue);
   }
 
-  template <typename U>
-  friend bool operator<(const optional& a, const U& b) {
-    if (not a.mHasValue) {
-      return true;
-    }
-    return *a < b;
+  void relocateValueTo(optional& target) {
+    relocateValueTo(target,
+                    typename optional_detail::relocation_strategy<T>::type());
   }
 
-  template <typename U>
-  friend bool operator<(const U& a, const optional& b) {
-    if (not b.mHasValue) {
-      return false;
-    }
-    return a < *b;
+  void relocateValueTo(optional& target, optional_detail::relocate_by_memcpy) {
+    std::memcpy(&target.mBuffer, &mBuffer, sizeof(T));
+    target.mHasValue = true;
+    mHasValue = false;
   }
 
-  friend bool operator<(nullopt_t, const optional& b) {
-     return b.mHasValue;
+#if __cplusplus >= 201103L
+  void relocateValueTo(optional& target, optional_detail::relocate_by_move) {
+    target.constructValue(std::move(*(*this)));
+    destructValue();
+  }
+#else
+  void relocateValueTo(optional& target, optional_detail::relocate_by_swap) {
+    target.constructValue();
+    using std::swap;
+    swap(*target, *(*this));
+    destructValue();
   }
 
-  friend bool operator<(const optional& a, nullopt_t) {
-     return false;
+  void relocateValueTo(optional& target, optional_detail::relocate_by_copy) {
+    target.constructValue(*(*this));
+    destructValue();
   }
+#endif
+};
 
-  friend bool operator>(const optional& a, const optional& b) {
-    return b < a;
+template <typename T>
+class optional<T&>
+    : public optional_detail::comparison_operators<optional<T&> > {
+ public:
+  typedef T value_type;
+
+  OPTIONALCPP_CONSTEXPR optional()
+      : mPointer(0) {}
+
+  OPTIONALCPP_CONSTEXPR optional(nullopt_t)
+      : mPointer(0) {}
+
+  OPTIONALCPP_CONSTEXPR optional(T& value)
+      : mPointer(&value) {}
+
+#if __cplusplus >= 201103L
+  optional(T&&) = delete;
+#endif
+
+  optional& operator=(nullopt_t) {
+    reset();
+    return *this;
   }
 
-  template <typename U>
-  friend bool operator>(const optional& a, const U& b) {
-    return b < a;
+  OPTIONALCPP_CONSTEXPR bool has_value() const {
+    return mPointer != 0;
   }
 
-  template <typename U>
-  friend bool operator>(const U& a, const optional& b) {
-    return b < a;
+  OPTIONALCPP_CONSTEXPR operator bool() const {
+    return mPointer != 0;
   }
 
-  friend bool operator>=(const optional& a, const optional& b) {
-    return !(a < b);
+  T& value() const {
+    checkAccess();
+    return *mPointer;
   }
 
-  template <typename U>
-  friend bool operator>=(const optional& a, const U& b) {
-    return !(a < b);
+  OPTIONALCPP_CONSTEXPR T& operator*() const {
+    return *mPointer;
+  }
+
+  OPTIONALCPP_CONSTEXPR T* operator->() const {
+    return mPointer;
   }
 
   template <typename U>
-  friend bool operator>=(const U& a, const optional& b) {
-    return !(a < b);
+  OPTIONALCPP_CONSTEXPR T& value_or(U& defaultValue) const {
+    return mPointer != 0 ? *mPointer : defaultValue;
   }
 
-  friend bool operator<=(const optional& a, const optional& b) {
-    return !(b < a);
+  void swap(optional& other) {
+    OPTIONALCPP_RECORD(T&, optional_swap);
+    std::swap(mPointer, other.mPointer);
   }
 
-  template <typename U>
-  friend bool operator<=(const optional& a, const U& b) {
-    return !(b < a);
+  void reset() {
+    mPointer = 0;
   }
 
-  template <typename U>
-  friend bool operator<=(const U& a, const optional<T>& b) {
-    return !(b < a);
+  T& emplace(T& value) {
+    mPointer = &value;
+    return value;
   }
 
   friend void swap(optional& a, optional& b) {
@@ -275,25 +1520,93 @@ class optional {
   }
 
  private:
-  bool mHasValue;
-
-  aligned_storage<sizeof(T), alignment_of<T>::value> mBuffer;
+  T* mPointer;
 
-  void throwInCaseOfBadAccess() const {
-    if (not mHasValue) {
-      throw bad_optional_access();
+  void checkAccess() const {
+#if defined(OPTIONALCPP_INSTRUMENTATION)
+    if (mPointer == 0) {
+      OPTIONALCPP_RECORD(T&, optional_bad_access);
     }
+#endif
+    optional_detail::check_access(mPointer != 0);
   }
+};
 
-  void constructValue(const T& other) {
-    new (&mBuffer.mStorage) T(other);
-    mHasValue = true;
-  }
+namespace optional_detail {
 
-  void destructValue() {
-    reinterpret_cast<T*>(&mBuffer.mStorage)->~T();
-    mHasValue = false;
+// Describes how an optional type spends its bytes. value_bytes hold the value
+// or the pointer to it, state_bytes the separate engaged flag, if any.
+template <typename Optional>
+struct optional_layout;
+
+template <typename T>
+struct optional_layout<optional<T> > {
+  static const std::size_t value_bytes = sizeof(T);
+  static const std::size_t state_bytes = sizeof(bool);
+  static const bool uses_sentinel = false;
+  static const bool is_trivially_copyable = has_trivial_copy<T>::value;
+};
+
+template <typename T>
+struct optional_layout<optional<T&> > {
+  static const std::size_t value_bytes = sizeof(T*);
+  static const std::size_t state_bytes = 0;
+  static const bool uses_sentinel = true;
+  static const bool is_trivially_copyable = true;
+};
+
+}  // namespace optional_detail
+
+// Compile-time layout of Optional, which holds a T. padding_bytes counts the
+// bytes that carry neither the value nor the engaged state.
+template <typename T, typename Optional = optional<T> >
+struct optional_traits {
+  typedef optional_detail::optional_layout<Optional> layout;
+
+  static const std::size_t size = sizeof(Optional);
+  static const std::size_t alignment = alignment_of<Optional>::value;
+  static const std::size_t padding_bytes =
+      size - layout::value_bytes - layout::state_bytes;
+  static const bool is_trivially_copyable = layout::is_trivially_copyable;
+  static const bool uses_sentinel = layout::uses_sentinel;
+};
+
+template <typename T, typename Optional>
+const std::size_t optional_traits<T, Optional>::size;
+
+template <typename T, typename Optional>
+const std::size_t optional_traits<T, Optional>::alignment;
+
+template <typename T, typename Optional>
+const std::size_t optional_traits<T, Optional>::padding_bytes;
+
+template <typename T, typename Optional>
+const bool optional_traits<T, Optional>::is_trivially_copyable;
+
+template <typename T, typename Optional>
+const bool optional_traits<T, Optional>::uses_sentinel;
+
+#if __cplusplus >= 201103L
+namespace optional_detail {
+
+const std::size_t empty_optional_hash =
+    static_cast<std::size_t>(0x9e3779b97f4a7c15ULL);
+
+}  // namespace optional_detail
+
+namespace std {
+
+template <typename T>
+struct hash< ::optional<T> > {
+  std::size_t operator()(const ::optional<T>& x) const {
+    typedef typename std::remove_cv<typename ::optional<T>::value_type>::type
+        value_type;
+    return x.has_value() ? std::hash<value_type>()(*x)
+                         : optional_detail::empty_optional_hash;
   }
 };
 
+}  // namespace std
+#endif
+
 #endif  // OPTIONALCPP_OPTIONAL_HPP
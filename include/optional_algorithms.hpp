@@ -0,0 +1,624 @@
+#ifndef OPTIONALCPP_OPTIONAL_ALGORITHMS_HPP
+#define OPTIONALCPP_OPTIONAL_ALGORITHMS_HPP
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+#include "optional.hpp"
+#include "optional_span.hpp"
+#include "optional_vector.hpp"
+
+#if !defined(OPTIONALCPP_NO_SIMD)
+#if defined(__AVX2__)
+#define OPTIONALCPP_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define OPTIONALCPP_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define OPTIONALCPP_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace optional_detail {
+
+struct scalar_lanes {};
+struct four_byte_lanes {};
+struct eight_byte_lanes {};
+
+template <typename T>
+struct simd_lanes {
+  typedef typename conditional<
+      is_arithmetic<T>::value && sizeof(T) == 4, four_byte_lanes,
+      typename conditional<is_arithmetic<T>::value && sizeof(T) == 8,
+                           eight_byte_lanes, scalar_lanes>::type>::type type;
+};
+
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, scalar_lanes) {
+  for (std::size_t i = 0; i < count; ++i) {
+    out[i] = ((word >> i) & 1) ? values[i] : fallback;
+  }
+}
+
+#if defined(OPTIONALCPP_AVX2)
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, four_byte_lanes) {
+  int32_t fallbackBits;
+  std::memcpy(&fallbackBits, &fallback, sizeof(T));
+  const __m256i fallbackLanes = _mm256_set1_epi32(fallbackBits);
+  const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i bits =
+        _mm256_set1_epi32(static_cast<int32_t>((word >> i) & 0xFF));
+    const __m256i mask =
+        _mm256_cmpeq_epi32(_mm256_and_si256(bits, laneBits), laneBits);
+    const __m256i lanes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_blendv_epi8(fallbackLanes, lanes, mask));
+  }
+  select_engaged(values + i, i < 64 ? word >> i : 0, fallback, out + i,
+                 count - i, scalar_lanes());
+}
+
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, eight_byte_lanes) {
+  long long fallbackBits;
+  std::memcpy(&fallbackBits, &fallback, sizeof(T));
+  const __m256i fallbackLanes = _mm256_set1_epi64x(fallbackBits);
+  const __m256i laneBits = _mm256_setr_epi64x(1, 2, 4, 8);
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m256i bits =
+        _mm256_set1_epi64x(static_cast<long long>((word >> i) & 0xF));
+    const __m256i mask =
+        _mm256_cmpeq_epi64(_mm256_and_si256(bits, laneBits), laneBits);
+    const __m256i lanes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_blendv_epi8(fallbackLanes, lanes, mask));
+  }
+  select_engaged(values + i, i < 64 ? word >> i : 0, fallback, out + i,
+                 count - i, scalar_lanes());
+}
+#elif defined(OPTIONALCPP_SSE2)
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, four_byte_lanes) {
+  int32_t fallbackBits;
+  std::memcpy(&fallbackBits, &fallback, sizeof(T));
+  const __m128i fallbackLanes = _mm_set1_epi32(fallbackBits);
+  const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i bits =
+        _mm_set1_epi32(static_cast<int32_t>((word >> i) & 0xF));
+    const __m128i mask =
+        _mm_cmpeq_epi32(_mm_and_si128(bits, laneBits), laneBits);
+    const __m128i lanes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_or_si128(_mm_and_si128(mask, lanes),
+                                  _mm_andnot_si128(mask, fallbackLanes)));
+  }
+  select_engaged(values + i, i < 64 ? word >> i : 0, fallback, out + i,
+                 count - i, scalar_lanes());
+}
+
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, eight_byte_lanes) {
+  int32_t fallbackBits[2];
+  std::memcpy(fallbackBits, &fallback, sizeof(T));
+  const __m128i fallbackLanes =
+      _mm_setr_epi32(fallbackBits[0], fallbackBits[1], fallbackBits[0],
+                     fallbackBits[1]);
+  const __m128i laneBits = _mm_setr_epi32(1, 1, 2, 2);
+  std::size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const __m128i bits =
+        _mm_set1_epi32(static_cast<int32_t>((word >> i) & 0x3));
+    const __m128i mask =
+        _mm_cmpeq_epi32(_mm_and_si128(bits, laneBits), laneBits);
+    const __m128i lanes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_or_si128(_mm_and_si128(mask, lanes),
+                                  _mm_andnot_si128(mask, fallbackLanes)));
+  }
+  select_engaged(values + i, i < 64 ? word >> i : 0, fallback, out + i,
+                 count - i, scalar_lanes());
+}
+#elif defined(OPTIONALCPP_NEON)
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, four_byte_lanes) {
+  uint32_t fallbackBits;
+  std::memcpy(&fallbackBits, &fallback, sizeof(T));
+  const uint32x4_t fallbackLanes = vdupq_n_u32(fallbackBits);
+  const uint32_t laneBitValues[4] = {1, 2, 4, 8};
+  const uint32x4_t laneBits = vld1q_u32(laneBitValues);
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const uint32x4_t mask = vtstq_u32(
+        vdupq_n_u32(static_cast<uint32_t>((word >> i) & 0xF)), laneBits);
+    const uint32x4_t lanes =
+        vld1q_u32(reinterpret_cast<const uint32_t*>(values + i));
+    vst1q_u32(reinterpret_cast<uint32_t*>(out + i),
+              vbslq_u32(mask, lanes, fallbackLanes));
+  }
+  select_engaged(values + i, i < 64 ? word >> i : 0, fallback, out + i,
+                 count - i, scalar_lanes());
+}
+
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, eight_byte_lanes) {
+  uint64_t fallbackBits;
+  std::memcpy(&fallbackBits, &fallback, sizeof(T));
+  const uint64x2_t fallbackLanes = vdupq_n_u64(fallbackBits);
+  const uint64_t laneBitValues[2] = {1, 2};
+  const uint64x2_t laneBits = vld1q_u64(laneBitValues);
+  std::size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const uint64x2_t mask = vtstq_u64(vdupq_n_u64((word >> i) & 0x3), laneBits);
+    const uint64x2_t lanes =
+        vld1q_u64(reinterpret_cast<const uint64_t*>(values + i));
+    vst1q_u64(reinterpret_cast<uint64_t*>(out + i),
+              vbslq_u64(mask, lanes, fallbackLanes));
+  }
+  select_engaged(values + i, i < 64 ? word >> i : 0, fallback, out + i,
+                 count - i, scalar_lanes());
+}
+#else
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, four_byte_lanes) {
+  select_engaged(values, word, fallback, out, count, scalar_lanes());
+}
+
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count, eight_byte_lanes) {
+  select_engaged(values, word, fallback, out, count, scalar_lanes());
+}
+#endif
+
+template <typename T>
+void select_engaged(const T* values, uint64_t word, const T& fallback,
+                    T* out, std::size_t count) {
+  select_engaged(values, word, fallback, out, count,
+                 typename simd_lanes<T>::type());
+}
+
+template <typename T>
+uint64_t equal_bits(const T* values, std::size_t count, const T& x,
+                    scalar_lanes) {
+  uint64_t bits = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    bits |= static_cast<uint64_t>(values[i] == x) << i;
+  }
+  return bits;
+}
+
+#if defined(OPTIONALCPP_AVX2) || defined(OPTIONALCPP_SSE2)
+template <typename T>
+uint64_t equal_bits(const T* values, std::size_t count, const T& x,
+                    four_byte_lanes) {
+  uint64_t bits = 0;
+  std::size_t i = 0;
+#if defined(OPTIONALCPP_AVX2)
+  int32_t xBits;
+  std::memcpy(&xBits, &x, sizeof(T));
+  const __m256i xLanes = _mm256_set1_epi32(xBits);
+  for (; i + 8 <= count; i += 8) {
+    const __m256i lanes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    const int mask = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(lanes, xLanes)));
+    bits |= static_cast<uint64_t>(mask) << i;
+  }
+#else
+  int32_t xBits;
+  std::memcpy(&xBits, &x, sizeof(T));
+  const __m128i xLanes = _mm_set1_epi32(xBits);
+  for (; i + 4 <= count; i += 4) {
+    const __m128i lanes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    const int mask =
+        _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lanes, xLanes)));
+    bits |= static_cast<uint64_t>(mask) << i;
+  }
+#endif
+  if (i < count) {
+    bits |= equal_bits(values + i, count - i, x, scalar_lanes()) << i;
+  }
+  return bits;
+}
+#endif
+
+template <typename T>
+struct equal_lanes {
+  typedef typename conditional<std::numeric_limits<T>::is_integer &&
+                                   sizeof(T) == 4,
+                               four_byte_lanes, scalar_lanes>::type type;
+};
+
+#if !defined(OPTIONALCPP_AVX2) && !defined(OPTIONALCPP_SSE2)
+template <typename T>
+uint64_t equal_bits(const T* values, std::size_t count, const T& x,
+                    four_byte_lanes) {
+  return equal_bits(values, count, x, scalar_lanes());
+}
+#endif
+
+template <typename T, typename Reduce>
+optional<T> reduce_engaged(const T* values, const uint64_t* presence,
+                           std::size_t size, const T& identity,
+                           Reduce reduce) {
+  T block[presence_word_bits];
+  T result = identity;
+  bool hasValue = false;
+  for (std::size_t w = 0; w < presence_word_count(size); ++w) {
+    const uint64_t word = engaged_word(presence, size, w);
+    if (word == 0) {
+      continue;
+    }
+    hasValue = true;
+    const std::size_t count = block_size(size, w);
+    select_engaged(values + w * presence_word_bits, word, identity, block,
+                   count);
+    for (std::size_t i = 0; i < count; ++i) {
+      result = reduce(result, block[i]);
+    }
+  }
+  return hasValue ? optional<T>(result) : optional<T>();
+}
+
+// The identities of min and max. Both also fill the slots of empty optionals,
+// so for floating point they have to be the infinities: starting from the
+// largest finite value would turn a minimum of +inf into that value.
+template <typename T>
+T highest() {
+  return std::numeric_limits<T>::has_infinity
+             ? std::numeric_limits<T>::infinity()
+             : std::numeric_limits<T>::max();
+}
+
+template <typename T>
+T lowest() {
+  return std::numeric_limits<T>::has_infinity
+             ? -std::numeric_limits<T>::infinity()
+             : std::numeric_limits<T>::is_integer
+                   ? std::numeric_limits<T>::min()
+                   : -std::numeric_limits<T>::max();
+}
+
+template <typename T>
+struct plus {
+  T operator()(const T& a, const T& b) const {
+    return a + b;
+  }
+};
+
+template <typename T>
+struct minimum {
+  T operator()(const T& a, const T& b) const {
+    return b < a ? b : a;
+  }
+};
+
+template <typename T>
+struct maximum {
+  T operator()(const T& a, const T& b) const {
+    return a < b ? b : a;
+  }
+};
+
+}  // namespace optional_detail
+
+inline std::size_t count_engaged(const uint64_t* presence, std::size_t size) {
+  std::size_t count = 0;
+  for (std::size_t w = 0; w < optional_detail::presence_word_count(size);
+       ++w) {
+    count += optional_detail::popcount(
+        optional_detail::engaged_word(presence, size, w));
+  }
+  return count;
+}
+
+template <typename T>
+void value_or_fill(const T* values, const uint64_t* presence,
+                   std::size_t size, const T& defaultValue, T* out) {
+  for (std::size_t w = 0; w < optional_detail::presence_word_count(size);
+       ++w) {
+    const std::size_t offset = w * optional_detail::presence_word_bits;
+    optional_detail::select_engaged(values + offset, presence[w],
+                                    defaultValue, out + offset,
+                                    optional_detail::block_size(size, w));
+  }
+}
+
+template <typename T>
+std::size_t compact_engaged(const T* values, const uint64_t* presence,
+                            std::size_t size, T* out) {
+  T* next = out;
+  for (std::size_t w = 0; w < optional_detail::presence_word_count(size);
+       ++w) {
+    const T* block = values + w * optional_detail::presence_word_bits;
+    for (uint64_t word = optional_detail::engaged_word(presence, size, w);
+         word != 0; word &= word - 1) {
+#if defined(__GNUC__)
+      *next++ = block[__builtin_ctzll(word)];
+#else
+      std::size_t index = 0;
+      while (((word >> index) & 1) == 0) {
+        ++index;
+      }
+      *next++ = block[index];
+#endif
+    }
+  }
+  return static_cast<std::size_t>(next - out);
+}
+
+template <typename T>
+T sum_engaged(const T* values, const uint64_t* presence, std::size_t size) {
+  return optional_detail::reduce_engaged(values, presence, size, T(),
+                                         optional_detail::plus<T>())
+      .value_or(T());
+}
+
+template <typename T>
+optional<T> min_engaged(const T* values, const uint64_t* presence,
+                        std::size_t size) {
+  return optional_detail::reduce_engaged(values, presence, size,
+                                         optional_detail::highest<T>(),
+                                         optional_detail::minimum<T>());
+}
+
+template <typename T>
+optional<T> max_engaged(const T* values, const uint64_t* presence,
+                        std::size_t size) {
+  return optional_detail::reduce_engaged(values, presence, size,
+                                         optional_detail::lowest<T>(),
+                                         optional_detail::maximum<T>());
+}
+
+template <typename T>
+void equal_engaged(const T* values, const uint64_t* presence,
+                   std::size_t size, const T& x, uint64_t* out) {
+  for (std::size_t w = 0; w < optional_detail::presence_word_count(size);
+       ++w) {
+    out[w] = optional_detail::engaged_word(presence, size, w) &
+             optional_detail::equal_bits(
+                 values + w * optional_detail::presence_word_bits,
+                 optional_detail::block_size(size, w), x,
+                 typename optional_detail::equal_lanes<T>::type());
+  }
+}
+
+template <typename T>
+std::size_t count_engaged(const optional_vector<T>& v) {
+  return v.count_engaged();
+}
+
+template <typename T>
+void value_or_fill(const optional_vector<T>& v, const T& defaultValue,
+                   T* out) {
+  value_or_fill(v.values(), v.presence(), v.size(), defaultValue, out);
+}
+
+template <typename T>
+std::size_t compact_engaged(const optional_vector<T>& v, T* out) {
+  return compact_engaged(v.values(), v.presence(), v.size(), out);
+}
+
+template <typename T>
+T sum_engaged(const optional_vector<T>& v) {
+  return sum_engaged(v.values(), v.presence(), v.size());
+}
+
+template <typename T>
+optional<T> min_engaged(const optional_vector<T>& v) {
+  return min_engaged(v.values(), v.presence(), v.size());
+}
+
+template <typename T>
+optional<T> max_engaged(const optional_vector<T>& v) {
+  return max_engaged(v.values(), v.presence(), v.size());
+}
+
+template <typename T>
+void equal_engaged(const optional_vector<T>& v, const T& x, uint64_t* out) {
+  equal_engaged(v.values(), v.presence(), v.size(), x, out);
+}
+
+template <typename T>
+std::size_t count_engaged(const optional_span<T>& s) {
+  return s.count_engaged();
+}
+
+template <typename T>
+void value_or_fill(const optional_span<T>& s, const T& defaultValue, T* out) {
+  value_or_fill(s.values(), s.presence(), s.size(), defaultValue, out);
+}
+
+template <typename T>
+std::size_t compact_engaged(const optional_span<T>& s, T* out) {
+  return compact_engaged(s.values(), s.presence(), s.size(), out);
+}
+
+template <typename T>
+T sum_engaged(const optional_span<T>& s) {
+  return sum_engaged(s.values(), s.presence(), s.size());
+}
+
+template <typename T>
+optional<T> min_engaged(const optional_span<T>& s) {
+  return min_engaged(s.values(), s.presence(), s.size());
+}
+
+template <typename T>
+optional<T> max_engaged(const optional_span<T>& s) {
+  return max_engaged(s.values(), s.presence(), s.size());
+}
+
+template <typename T>
+void equal_engaged(const optional_span<T>& s, const T& x, uint64_t* out) {
+  equal_engaged(s.values(), s.presence(), s.size(), x, out);
+}
+
+template <typename T>
+std::size_t count_engaged(const optional<T>* first, const optional<T>* last) {
+  std::size_t count = 0;
+  for (; first != last; ++first) {
+    count += first->has_value();
+  }
+  return count;
+}
+
+template <typename T>
+void value_or_fill(const optional<T>* first, const optional<T>* last,
+                   const T& defaultValue, T* out) {
+  for (; first != last; ++first, ++out) {
+    *out = first->has_value() ? **first : defaultValue;
+  }
+}
+
+template <typename T>
+std::size_t compact_engaged(const optional<T>* first, const optional<T>* last,
+                            T* out) {
+  T* next = out;
+  for (; first != last; ++first) {
+    if (first->has_value()) {
+      *next++ = **first;
+    }
+  }
+  return static_cast<std::size_t>(next - out);
+}
+
+template <typename T>
+T sum_engaged(const optional<T>* first, const optional<T>* last) {
+  T sum = T();
+  for (; first != last; ++first) {
+    sum += first->has_value() ? **first : T();
+  }
+  return sum;
+}
+
+template <typename T>
+optional<T> min_engaged(const optional<T>* first, const optional<T>* last) {
+  optional<T> result;
+  for (; first != last; ++first) {
+    if (first->has_value() && (not result.has_value() || **first < *result)) {
+      result = *first;
+    }
+  }
+  return result;
+}
+
+template <typename T>
+optional<T> max_engaged(const optional<T>* first, const optional<T>* last) {
+  optional<T> result;
+  for (; first != last; ++first) {
+    if (first->has_value() && (not result.has_value() || *result < **first)) {
+      result = *first;
+    }
+  }
+  return result;
+}
+
+// Writes the same bitmap as the overloads for separate values and presence.
+template <typename T>
+void equal_engaged(const optional<T>* first, const optional<T>* last,
+                   const T& x, uint64_t* out) {
+  const std::size_t size = static_cast<std::size_t>(last - first);
+  for (std::size_t w = 0; w < optional_detail::presence_word_count(size);
+       ++w) {
+    const optional<T>* const block =
+        first + w * optional_detail::presence_word_bits;
+    uint64_t word = 0;
+    for (std::size_t i = 0; i < optional_detail::block_size(size, w); ++i) {
+      word |= uint64_t(block[i] == x) << i;
+    }
+    out[w] = word;
+  }
+}
+
+#if __cplusplus >= 201103L
+namespace optional_detail {
+
+template <typename T>
+std::size_t* hash_range(const optional<T>* first, const optional<T>* last,
+                        std::size_t* out, true_type) {
+  const std::hash<T> hasher;
+  for (; first != last; ++first, ++out) {
+    const std::size_t hash = hasher(**first);
+    *out = first->has_value() ? hash : empty_optional_hash;
+  }
+  return out;
+}
+
+template <typename T>
+std::size_t* hash_range(const optional<T>* first, const optional<T>* last,
+                        std::size_t* out, false_type) {
+  const std::hash<optional<T> > hasher;
+  for (; first != last; ++first, ++out) {
+    *out = hasher(*first);
+  }
+  return out;
+}
+
+}  // namespace optional_detail
+
+template <typename InputIterator, typename OutputIterator>
+OutputIterator hash_range(InputIterator first, InputIterator last,
+                          OutputIterator out) {
+  typedef typename std::iterator_traits<InputIterator>::value_type
+      optional_type;
+  const std::hash<optional_type> hasher;
+  for (; first != last; ++first, ++out) {
+    *out = hasher(*first);
+  }
+  return out;
+}
+
+template <typename T>
+std::size_t* hash_range(const optional<T>* first, const optional<T>* last,
+                        std::size_t* out) {
+  return optional_detail::hash_range(
+      first, last, out, optional_detail::holds_value_when_empty<T>());
+}
+
+template <typename T>
+std::size_t* hash_range(optional<T>* first, optional<T>* last,
+                        std::size_t* out) {
+  return hash_range(static_cast<const optional<T>*>(first),
+                    static_cast<const optional<T>*>(last), out);
+}
+
+template <typename T>
+std::size_t* hash_range(const optional_vector<T>& v, std::size_t* out) {
+  const std::hash<T> hasher;
+  const T* values = v.values();
+  for (std::size_t i = 0; i < v.size(); ++i) {
+    const std::size_t hash = hasher(values[i]);
+    out[i] = v.has_value(i) ? hash : optional_detail::empty_optional_hash;
+  }
+  return out + v.size();
+}
+#endif
+
+#endif  // OPTIONALCPP_OPTIONAL_ALGORITHMS_HPP
@@ -0,0 +1,217 @@
+#ifndef OPTIONALCPP_OPTIONAL_INSTRUMENTATION_HPP
+#define OPTIONALCPP_OPTIONAL_INSTRUMENTATION_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <typeinfo>
+
+#if __cplusplus >= 201103L
+#include <atomic>
+#endif
+
+// Counters and hooks for the events of optionals, compiled in only when
+// OPTIONALCPP_INSTRUMENTATION is defined before optional.hpp is included.
+// The counters are kept per value type. Before C++11 they are not atomic.
+
+enum optional_event {
+  optional_construction,
+  optional_destruction,
+  optional_copy,
+  optional_move,
+  optional_swap,
+  optional_bad_access,
+  optional_event_count
+};
+
+struct optional_counters {
+  std::size_t constructions;
+  std::size_t destructions;
+  std::size_t copies;
+  std::size_t moves;
+  std::size_t swaps;
+  std::size_t bad_accesses;
+};
+
+typedef void (*optional_hook)(optional_event event, const char* type_name);
+
+namespace optional_detail {
+
+#if __cplusplus >= 201103L
+typedef std::atomic<std::size_t> event_counter;
+
+inline void increment(event_counter& counter) {
+  counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline std::size_t load(const event_counter& counter) {
+  return counter.load(std::memory_order_relaxed);
+}
+
+inline void clear(event_counter& counter) {
+  counter.store(0, std::memory_order_relaxed);
+}
+#else
+typedef std::size_t event_counter;
+
+inline void increment(event_counter& counter) {
+  ++counter;
+}
+
+inline std::size_t load(const event_counter& counter) {
+  return counter;
+}
+
+inline void clear(event_counter& counter) {
+  counter = 0;
+}
+#endif
+
+// The counters of one value type. Every node links itself into a global list
+// on first use, so that the report can visit all types.
+struct counter_node {
+  explicit counter_node(const char* name);
+
+  const char* mName;
+  event_counter mCounts[optional_event_count];
+  counter_node* mNext;
+
+  optional_counters snapshot() const {
+    optional_counters counters;
+    counters.constructions = load(mCounts[optional_construction]);
+    counters.destructions = load(mCounts[optional_destruction]);
+    counters.copies = load(mCounts[optional_copy]);
+    counters.moves = load(mCounts[optional_move]);
+    counters.swaps = load(mCounts[optional_swap]);
+    counters.bad_accesses = load(mCounts[optional_bad_access]);
+    return counters;
+  }
+};
+
+#if __cplusplus >= 201103L
+inline std::atomic<counter_node*>& counter_nodes() {
+  static std::atomic<counter_node*> head(nullptr);
+  return head;
+}
+
+inline counter_node::counter_node(const char* name)
+    : mName(name), mNext(counter_nodes().load(std::memory_order_relaxed)) {
+  for (int i = 0; i < optional_event_count; ++i) {
+    clear(mCounts[i]);
+  }
+  while (not counter_nodes().compare_exchange_weak(
+      mNext, this, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+}
+
+inline counter_node* first_counter_node() {
+  return counter_nodes().load(std::memory_order_acquire);
+}
+
+inline std::atomic<optional_hook>& installed_optional_hook() {
+  static std::atomic<optional_hook> hook(nullptr);
+  return hook;
+}
+#else
+inline counter_node*& counter_nodes() {
+  static counter_node* head = 0;
+  return head;
+}
+
+inline counter_node::counter_node(const char* name)
+    : mName(name), mNext(counter_nodes()) {
+  for (int i = 0; i < optional_event_count; ++i) {
+    clear(mCounts[i]);
+  }
+  counter_nodes() = this;
+}
+
+inline counter_node* first_counter_node() {
+  return counter_nodes();
+}
+
+inline optional_hook& installed_optional_hook() {
+  static optional_hook hook = 0;
+  return hook;
+}
+#endif
+
+template <typename T>
+counter_node& counters_of() {
+  static counter_node node(typeid(T).name());
+  return node;
+}
+
+template <typename T>
+void record_event(optional_event event) {
+  counter_node& node = counters_of<T>();
+  increment(node.mCounts[event]);
+  const optional_hook hook = installed_optional_hook();
+  if (hook != 0) {
+    hook(event, node.mName);
+  }
+}
+
+}  // namespace optional_detail
+
+// Installs a hook that is called for every event, in addition to counting
+// it, and returns the previous one. Passing 0 removes the hook.
+inline optional_hook set_optional_hook(optional_hook hook) {
+#if __cplusplus >= 201103L
+  return optional_detail::installed_optional_hook().exchange(hook);
+#else
+  const optional_hook previous = optional_detail::installed_optional_hook();
+  optional_detail::installed_optional_hook() = hook;
+  return previous;
+#endif
+}
+
+inline optional_hook get_optional_hook() {
+  return optional_detail::installed_optional_hook();
+}
+
+template <typename T>
+optional_counters get_optional_counters() {
+  return optional_detail::counters_of<T>().snapshot();
+}
+
+// Calls visit(type_name, counters) for every value type with counters.
+template <typename Visitor>
+void for_each_optional_counters(Visitor visit) {
+  for (const optional_detail::counter_node* node =
+           optional_detail::first_counter_node();
+       node != 0; node = node->mNext) {
+    visit(node->mName, node->snapshot());
+  }
+}
+
+inline void reset_optional_counters() {
+  for (optional_detail::counter_node* node =
+           optional_detail::first_counter_node();
+       node != 0; node = node->mNext) {
+    for (int i = 0; i < optional_event_count; ++i) {
+      optional_detail::clear(node->mCounts[i]);
+    }
+  }
+}
+
+// Prints one line per value type; the names are those of std::type_info.
+inline void print_optional_counters(std::FILE* out) {
+  std::fprintf(out, "%-40s %12s %12s %12s %12s %12s %12s\n", "type",
+               "constructed", "destroyed", "copied", "moved", "swapped",
+               "bad access");
+  for (const optional_detail::counter_node* node =
+           optional_detail::first_counter_node();
+       node != 0; node = node->mNext) {
+    const optional_counters counters = node->snapshot();
+    std::fprintf(out, "%-40s %12lu %12lu %12lu %12lu %12lu %12lu\n",
+                 node->mName,
+                 static_cast<unsigned long>(counters.constructions),
+                 static_cast<unsigned long>(counters.destructions),
+                 static_cast<unsigned long>(counters.copies),
+                 static_cast<unsigned long>(counters.moves),
+                 static_cast<unsigned long>(counters.swaps),
+                 static_cast<unsigned long>(counters.bad_accesses));
+  }
+}
+
+#endif  // OPTIONALCPP_OPTIONAL_INSTRUMENTATION_HPP
@@ -0,0 +1,310 @@
+#ifndef OPTIONALCPP_OPTIONAL_SERIALIZATION_HPP
+#define OPTIONALCPP_OPTIONAL_SERIALIZATION_HPP
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#if __cplusplus >= 201103L
+#include <type_traits>
+#endif
+
+#include "optional.hpp"
+#include "optional_vector.hpp"
+
+// A serialized block of optionals has the layout
+//
+//   uint32_t magic          serialized_block_magic
+//   uint32_t value_size     sizeof(T)
+//   uint64_t count          number of optionals
+//   uint64_t presence[]     one bit per optional, (count + 63) / 64 words
+//   T        values[count]  empty optionals hold zero bytes
+//
+// with the values starting at the next multiple of alignof(T) and the block
+// padded to a multiple of max(8, alignof(T)), so that blocks can be written
+// back to back. The fields use the byte order of the writer; a reader with
+// a different byte order sees a wrong magic and rejects the block.
+//
+// The writer copies the bytes of the values, so it only accepts types without
+// padding bytes, whose indeterminate contents would end up in the block:
+// types with unique object representations, float and double in C++17, and
+// arithmetic types other than long double before.
+
+const uint32_t serialized_block_magic = 0x3154504fu;
+
+namespace optional_detail {
+
+const std::size_t serialized_header_size = 16;
+
+#if __cplusplus >= 201103L
+template <typename T>
+struct has_no_padding
+    : bool_constant<
+#if __cplusplus >= 201703L
+          std::has_unique_object_representations<T>::value ||
+          std::is_same<T, float>::value || std::is_same<T, double>::value
+#else
+          std::is_arithmetic<T>::value &&
+          not std::is_same<T, long double>::value
+#endif
+          > {
+};
+#endif
+
+template <typename T>
+struct serialized_layout {
+  static const std::size_t alignment =
+      alignment_of<T>::value > 8 ? alignment_of<T>::value : 8;
+
+  static std::size_t round_up(std::size_t size, std::size_t multiple) {
+    return (size + multiple - 1) / multiple * multiple;
+  }
+
+  static std::size_t values_offset(std::size_t count) {
+    return round_up(serialized_header_size +
+                        presence_word_count(count) * sizeof(uint64_t),
+                    alignment_of<T>::value);
+  }
+
+  static std::size_t block_size(std::size_t count) {
+    return round_up(values_offset(count) + count * sizeof(T), alignment);
+  }
+};
+
+}  // namespace optional_detail
+
+template <typename T>
+std::size_t serialized_size(std::size_t count) {
+  return optional_detail::serialized_layout<T>::block_size(count);
+}
+
+// Views a serialized block in place, e.g. inside a memory mapped file. The
+// buffer has to stay alive and be aligned to max(8, alignof(T)).
+template <typename T>
+class optional_array_view {
+#if __cplusplus >= 201103L
+  static_assert(optional_detail::is_trivially_copyable<T>::value,
+                "serialized optionals require a trivially copyable type");
+#endif
+
+  typedef optional_detail::serialized_layout<T> layout;
+
+ public:
+  typedef T value_type;
+  typedef std::size_t size_type;
+  typedef optional_detail::optional_vector_reference<T, const T,
+                                                     const uint64_t>
+      const_reference;
+
+  optional_array_view()
+      : mPresence(0), mValues(0), mSize(0), mValid(false) {}
+
+  optional_array_view(const void* data, std::size_t bytes)
+      : mPresence(0), mValues(0), mSize(0), mValid(false) {
+    const unsigned char* block = static_cast<const unsigned char*>(data);
+    if (block == 0 || bytes < optional_detail::serialized_header_size ||
+        reinterpret_cast<uintptr_t>(block) % layout::alignment != 0) {
+      return;
+    }
+    uint32_t header[2];
+    uint64_t count;
+    std::memcpy(header, block, sizeof(header));
+    std::memcpy(&count, block + sizeof(header), sizeof(count));
+    // Bounds the count before computing sizes from it to avoid overflow.
+    if (header[0] != serialized_block_magic || header[1] != sizeof(T) ||
+        count > bytes / sizeof(T) || layout::block_size(count) > bytes) {
+      return;
+    }
+    mSize = static_cast<std::size_t>(count);
+    mPresence = reinterpret_cast<const uint64_t*>(
+        block + optional_detail::serialized_header_size);
+    mValues =
+        reinterpret_cast<const T*>(block + layout::values_offset(mSize));
+    mValid = true;
+  }
+
+  bool valid() const {
+    return mValid;
+  }
+
+  size_type size() const {
+    return mSize;
+  }
+
+  bool empty() const {
+    return mSize == 0;
+  }
+
+  // The number of bytes of the block, which is also the offset of the next
+  // block in a stream.
+  std::size_t byte_size() const {
+    return mValid ? layout::block_size(mSize) : 0;
+  }
+
+  const_reference operator[](size_type index) const {
+    return const_reference(
+        mValues[index], mPresence[index / optional_detail::presence_word_bits],
+        optional_detail::presence_mask(index));
+  }
+
+  bool has_value(size_type index) const {
+    return (mPresence[index / optional_detail::presence_word_bits] &
+            optional_detail::presence_mask(index)) != 0;
+  }
+
+  // A block from a file may have stray bits past the end, so the last word
+  // is masked.
+  size_type count_engaged() const {
+    size_type count = 0;
+    for (size_type i = 0; i < presence_words(); ++i) {
+      count += optional_detail::popcount(
+          optional_detail::engaged_word(mPresence, mSize, i));
+    }
+    return count;
+  }
+
+  const T* values() const {
+    return mValues;
+  }
+
+  const uint64_t* presence() const {
+    return mPresence;
+  }
+
+  size_type presence_words() const {
+    return optional_detail::presence_word_count(mSize);
+  }
+
+ private:
+  const uint64_t* mPresence;
+  const T* mValues;
+  std::size_t mSize;
+  bool mValid;
+};
+
+// Appends blocks of optionals to a sink with a write(const char*, size)
+// member, such as std::ostream. Values are staged in a fixed buffer, so
+// writing allocates nothing.
+template <typename T, typename Sink>
+class optional_writer {
+#if __cplusplus >= 201103L
+  static_assert(optional_detail::is_trivially_copyable<T>::value,
+                "serialized optionals require a trivially copyable type");
+  static_assert(optional_detail::has_no_padding<T>::value,
+                "serialized optionals require a type without padding bytes");
+#endif
+
+  typedef optional_detail::serialized_layout<T> layout;
+
+ public:
+  explicit optional_writer(Sink& sink)
+      : mSink(&sink), mBytesWritten(0), mBlockStart(0), mBuffered(0) {}
+
+  void write(const optional<T>* first, const optional<T>* last) {
+    const std::size_t count = static_cast<std::size_t>(last - first);
+    writeHeader(count);
+    const std::size_t bits = optional_detail::presence_word_bits;
+    for (std::size_t i = 0; i < count; i += bits) {
+      const std::size_t end = std::min(count, i + bits);
+      uint64_t word = 0;
+      for (std::size_t j = i; j < end; ++j) {
+        word |= uint64_t(first[j].has_value()) << (j - i);
+      }
+      append(&word, sizeof(word));
+    }
+    padTo(layout::values_offset(count));
+    for (const optional<T>* it = first; it != last; ++it) {
+      if (it->has_value()) {
+        append(&(**it), sizeof(T));
+      } else {
+        appendZeros(sizeof(T));
+      }
+    }
+    padTo(layout::block_size(count));
+    flush();
+  }
+
+  // The storage of an optional vector already has the serialized layout.
+  void write(const optional_vector<T>& values) {
+    const std::size_t count = values.size();
+    writeHeader(count);
+    append(values.presence(), values.presence_words() * sizeof(uint64_t));
+    padTo(layout::values_offset(count));
+    for (std::size_t i = 0; i < count; ++i) {
+      if (values.has_value(i)) {
+        append(values.values() + i, sizeof(T));
+      } else {
+        // Empty slots may hold stale values, which must not leak out.
+        appendZeros(sizeof(T));
+      }
+    }
+    padTo(layout::block_size(count));
+    flush();
+  }
+
+  std::size_t bytes_written() const {
+    return mBytesWritten;
+  }
+
+ private:
+  static const std::size_t buffer_size = 4096;
+
+  Sink* mSink;
+  std::size_t mBytesWritten;
+  std::size_t mBlockStart;
+  std::size_t mBuffered;
+  char mBuffer[buffer_size];
+
+  void writeHeader(std::size_t count) {
+    mBlockStart = mBytesWritten + mBuffered;
+    const uint32_t header[2] = {serialized_block_magic, sizeof(T)};
+    const uint64_t size = count;
+    append(header, sizeof(header));
+    append(&size, sizeof(size));
+  }
+
+  void append(const void* data, std::size_t bytes) {
+    const char* source = static_cast<const char*>(data);
+    if (bytes >= buffer_size) {
+      flush();
+      mSink->write(source, bytes);
+      mBytesWritten += bytes;
+      return;
+    }
+    if (mBuffered + bytes > buffer_size) {
+      flush();
+    }
+    std::memcpy(mBuffer + mBuffered, source, bytes);
+    mBuffered += bytes;
+  }
+
+  void appendZeros(std::size_t bytes) {
+    while (bytes > 0) {
+      if (mBuffered == buffer_size) {
+        flush();
+      }
+      const std::size_t chunk = std::min(bytes, buffer_size - mBuffered);
+      std::memset(mBuffer + mBuffered, 0, chunk);
+      mBuffered += chunk;
+      bytes -= chunk;
+    }
+  }
+
+  void padTo(std::size_t offset) {
+    appendZeros(mBlockStart + offset - (mBytesWritten + mBuffered));
+  }
+
+  void flush() {
+    if (mBuffered > 0) {
+      mSink->write(mBuffer, mBuffered);
+      mBytesWritten += mBuffered;
+      mBuffered = 0;
+    }
+  }
+};
+
+template <typename T, typename Sink>
+const std::size_t optional_writer<T, Sink>::buffer_size;
+
+#endif  // OPTIONALCPP_OPTIONAL_SERIALIZATION_HPP
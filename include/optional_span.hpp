@@ -0,0 +1,93 @@
+#ifndef OPTIONALCPP_OPTIONAL_SPAN_HPP
+#define OPTIONALCPP_OPTIONAL_SPAN_HPP
+
+#include <stdint.h>
+
+#include <cassert>
+#include <cstddef>
+
+#include "optional.hpp"
+#include "optional_vector.hpp"
+
+// A read-only view over optionals stored elsewhere as a values buffer and a
+// validity bitmap with one bit per value, least significant bit first, as in
+// Arrow columns. Nothing is copied; the buffers have to outlive the span.
+template <typename T>
+class optional_span {
+ public:
+  typedef T value_type;
+  typedef std::size_t size_type;
+  typedef optional_detail::optional_vector_reference<T, const T,
+                                                     const uint64_t>
+      const_reference;
+  typedef const_reference reference;
+
+  optional_span()
+      : mValues(0), mValidity(0), mSize(0) {}
+
+  optional_span(const T* values, const uint64_t* validity, size_type size)
+      : mValues(values), mValidity(validity), mSize(size) {}
+
+  optional_span(const optional_vector<T>& values)
+      : mValues(values.values())
+      , mValidity(values.presence())
+      , mSize(values.size()) {}
+
+  size_type size() const {
+    return mSize;
+  }
+
+  bool empty() const {
+    return mSize == 0;
+  }
+
+  const_reference operator[](size_type index) const {
+    return const_reference(
+        mValues[index], mValidity[index / optional_detail::presence_word_bits],
+        optional_detail::presence_mask(index));
+  }
+
+  bool has_value(size_type index) const {
+    return (mValidity[index / optional_detail::presence_word_bits] &
+            optional_detail::presence_mask(index)) != 0;
+  }
+
+  // Bits past the end of the span may be set in external bitmaps, so the
+  // last word is masked.
+  size_type count_engaged() const {
+    size_type count = 0;
+    for (size_type i = 0; i < presence_words(); ++i) {
+      count += optional_detail::popcount(
+          optional_detail::engaged_word(mValidity, mSize, i));
+    }
+    return count;
+  }
+
+  // Views count elements starting at index, which has to be a multiple of 64
+  // so that the bitmap of the subspan starts at a word boundary.
+  optional_span subspan(size_type index, size_type count) const {
+    const size_type bits = optional_detail::presence_word_bits;
+    assert(index % bits == 0);
+    assert(index + count <= mSize);
+    return optional_span(mValues + index, mValidity + index / bits, count);
+  }
+
+  const T* values() const {
+    return mValues;
+  }
+
+  const uint64_t* presence() const {
+    return mValidity;
+  }
+
+  size_type presence_words() const {
+    return optional_detail::presence_word_count(mSize);
+  }
+
+ private:
+  const T* mValues;
+  const uint64_t* mValidity;
+  size_type mSize;
+};
+
+#endif  // OPTIONALCPP_OPTIONAL_SPAN_HPP
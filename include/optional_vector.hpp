@@ -0,0 +1,458 @@
+#ifndef OPTIONALCPP_OPTIONAL_VECTOR_HPP
+#define OPTIONALCPP_OPTIONAL_VECTOR_HPP
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "optional.hpp"
+
+template <typename T>
+class optional_vector;
+
+namespace optional_detail {
+
+const std::size_t presence_word_bits = 64;
+
+inline std::size_t popcount(uint64_t word) {
+#if defined(__GNUC__)
+  return static_cast<std::size_t>(__builtin_popcountll(word));
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ULL);
+  word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+  word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<std::size_t>((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+inline std::size_t presence_word_count(std::size_t size) {
+  return (size + presence_word_bits - 1) / presence_word_bits;
+}
+
+inline uint64_t presence_mask(std::size_t index) {
+  return uint64_t(1) << (index % presence_word_bits);
+}
+
+inline std::size_t block_size(std::size_t size, std::size_t word) {
+  return std::min(presence_word_bits, size - word * presence_word_bits);
+}
+
+// Clears the bits past the end, which external bitmaps may leave set.
+inline uint64_t engaged_word(const uint64_t* presence, std::size_t size,
+                             std::size_t word) {
+  const std::size_t bits = block_size(size, word);
+  return bits == presence_word_bits
+             ? presence[word]
+             : presence[word] & ((uint64_t(1) << bits) - 1);
+}
+
+template <typename T, typename Value, typename Word>
+class optional_vector_reference
+    : public comparison_operators<optional_vector_reference<T, Value, Word> > {
+ public:
+  typedef T value_type;
+
+  optional_vector_reference(Value& value, Word& word, uint64_t mask)
+      : mValue(&value)
+      , mWord(&word)
+      , mMask(mask) {}
+
+  const optional_vector_reference& operator=(
+      const optional_vector_reference& other) const {
+    if (other.has_value()) {
+      *this = *other;
+    } else {
+      reset();
+    }
+    return *this;
+  }
+
+  const optional_vector_reference& operator=(const optional<T>& other) const {
+    if (other.has_value()) {
+      *this = *other;
+    } else {
+      reset();
+    }
+    return *this;
+  }
+
+  const optional_vector_reference& operator=(const Value& value) const {
+    *mValue = value;
+    *mWord |= mMask;
+    return *this;
+  }
+
+  const optional_vector_reference& operator=(nullopt_t) const {
+    reset();
+    return *this;
+  }
+
+  operator optional<T>() const {
+    return has_value() ? optional<T>(*mValue) : optional<T>();
+  }
+
+  bool has_value() const {
+    return (*mWord & mMask) != 0;
+  }
+
+  operator bool() const {
+    return has_value();
+  }
+
+  Value& value() const {
+    check_access(has_value());
+    return *mValue;
+  }
+
+  Value& operator*() const {
+    return *mValue;
+  }
+
+  Value* operator->() const {
+    return mValue;
+  }
+
+  template <typename U>
+  T value_or(const U& defaultValue) const {
+    return has_value() ? *mValue : static_cast<T>(defaultValue);
+  }
+
+  void reset() const {
+    *mWord &= ~mMask;
+  }
+
+  friend void swap(const optional_vector_reference& a,
+                   const optional_vector_reference& b) {
+    using std::swap;
+    swap(*a.mValue, *b.mValue);
+    const bool aHasValue = a.has_value();
+    if (b.has_value()) {
+      *a.mWord |= a.mMask;
+    } else {
+      *a.mWord &= ~a.mMask;
+    }
+    if (aHasValue) {
+      *b.mWord |= b.mMask;
+    } else {
+      *b.mWord &= ~b.mMask;
+    }
+  }
+
+ private:
+  Value* mValue;
+  Word* mWord;
+  uint64_t mMask;
+};
+
+// Dereferences to a reference proxy, like the iterators of std::vector<bool>.
+template <typename T, bool Const>
+class optional_vector_iterator {
+  typedef typename conditional<Const, const optional_vector<T>,
+                               optional_vector<T> >::type vector_type;
+
+  struct not_convertible {};
+
+  typedef typename conditional<Const, optional_vector_iterator<T, false>,
+                               not_convertible>::type mutable_iterator;
+
+ public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef optional<T> value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef void pointer;
+  typedef typename conditional<
+      Const, optional_vector_reference<T, const T, const uint64_t>,
+      optional_vector_reference<T, T, uint64_t> >::type reference;
+
+  optional_vector_iterator()
+      : mVector(0), mIndex(0) {}
+
+  optional_vector_iterator(vector_type* vector, std::size_t index)
+      : mVector(vector), mIndex(index) {}
+
+  // Converts an iterator to a const_iterator, but not the other way.
+  optional_vector_iterator(const mutable_iterator& other)
+      : mVector(other.mVector), mIndex(other.mIndex) {}
+
+  reference operator*() const {
+    return (*mVector)[mIndex];
+  }
+
+  reference operator[](difference_type offset) const {
+    return (*mVector)[mIndex + offset];
+  }
+
+  optional_vector_iterator& operator++() {
+    ++mIndex;
+    return *this;
+  }
+
+  optional_vector_iterator operator++(int) {
+    optional_vector_iterator previous = *this;
+    ++mIndex;
+    return previous;
+  }
+
+  optional_vector_iterator& operator--() {
+    --mIndex;
+    return *this;
+  }
+
+  optional_vector_iterator operator--(int) {
+    optional_vector_iterator previous = *this;
+    --mIndex;
+    return previous;
+  }
+
+  optional_vector_iterator& operator+=(difference_type offset) {
+    mIndex += offset;
+    return *this;
+  }
+
+  optional_vector_iterator& operator-=(difference_type offset) {
+    mIndex -= offset;
+    return *this;
+  }
+
+  friend optional_vector_iterator operator+(optional_vector_iterator it,
+                                            difference_type offset) {
+    return it += offset;
+  }
+
+  friend optional_vector_iterator operator+(difference_type offset,
+                                            optional_vector_iterator it) {
+    return it += offset;
+  }
+
+  friend optional_vector_iterator operator-(optional_vector_iterator it,
+                                            difference_type offset) {
+    return it -= offset;
+  }
+
+  friend difference_type operator-(const optional_vector_iterator& a,
+                                   const optional_vector_iterator& b) {
+    return static_cast<difference_type>(a.mIndex) -
+           static_cast<difference_type>(b.mIndex);
+  }
+
+  friend bool operator==(const optional_vector_iterator& a,
+                         const optional_vector_iterator& b) {
+    return a.mIndex == b.mIndex;
+  }
+
+  friend bool operator!=(const optional_vector_iterator& a,
+                         const optional_vector_iterator& b) {
+    return a.mIndex != b.mIndex;
+  }
+
+  friend bool operator<(const optional_vector_iterator& a,
+                        const optional_vector_iterator& b) {
+    return a.mIndex < b.mIndex;
+  }
+
+  friend bool operator>(const optional_vector_iterator& a,
+                        const optional_vector_iterator& b) {
+    return a.mIndex > b.mIndex;
+  }
+
+  friend bool operator<=(const optional_vector_iterator& a,
+                         const optional_vector_iterator& b) {
+    return a.mIndex <= b.mIndex;
+  }
+
+  friend bool operator>=(const optional_vector_iterator& a,
+                         const optional_vector_iterator& b) {
+    return a.mIndex >= b.mIndex;
+  }
+
+ private:
+  friend class optional_vector_iterator<T, true>;
+
+  vector_type* mVector;
+  std::size_t mIndex;
+};
+
+}  // namespace optional_detail
+
+template <typename T>
+class optional_vector {
+ public:
+  typedef T value_type;
+  typedef std::size_t size_type;
+  typedef optional_detail::optional_vector_reference<T, T, uint64_t> reference;
+  typedef optional_detail::optional_vector_reference<T, const T,
+                                                     const uint64_t>
+      const_reference;
+  typedef optional_detail::optional_vector_iterator<T, false> iterator;
+  typedef optional_detail::optional_vector_iterator<T, true> const_iterator;
+
+  optional_vector() {}
+
+  explicit optional_vector(size_type size)
+      : mValues(size)
+      , mPresence(optional_detail::presence_word_count(size)) {}
+
+  optional_vector(size_type size, const T& value)
+      : mValues(size, value)
+      , mPresence(optional_detail::presence_word_count(size), ~uint64_t(0)) {
+    clearUnusedBits();
+  }
+
+  size_type size() const {
+    return mValues.size();
+  }
+
+  bool empty() const {
+    return mValues.empty();
+  }
+
+  void reserve(size_type capacity) {
+    mValues.reserve(capacity);
+    mPresence.reserve(optional_detail::presence_word_count(capacity));
+  }
+
+  void clear() {
+    mValues.clear();
+    mPresence.clear();
+  }
+
+  void resize(size_type size) {
+    mValues.resize(size);
+    mPresence.resize(optional_detail::presence_word_count(size));
+    clearUnusedBits();
+  }
+
+  void push_back(const T& value) {
+    reservePresence();
+    mValues.push_back(value);
+    appendPresence(true);
+  }
+
+#if __cplusplus >= 201103L
+  void push_back(T&& value) {
+    reservePresence();
+    mValues.push_back(std::move(value));
+    appendPresence(true);
+  }
+#endif
+
+  void push_back(nullopt_t) {
+    reservePresence();
+    mValues.push_back(T());
+    appendPresence(false);
+  }
+
+  void push_back(const optional<T>& value) {
+    if (value.has_value()) {
+      push_back(*value);
+    } else {
+      push_back(nullopt);
+    }
+  }
+
+  void pop_back() {
+    mValues.pop_back();
+    mPresence.resize(optional_detail::presence_word_count(mValues.size()));
+    clearUnusedBits();
+  }
+
+  reference operator[](size_type index) {
+    return reference(mValues[index],
+                     mPresence[index / optional_detail::presence_word_bits],
+                     optional_detail::presence_mask(index));
+  }
+
+  const_reference operator[](size_type index) const {
+    return const_reference(
+        mValues[index], mPresence[index / optional_detail::presence_word_bits],
+        optional_detail::presence_mask(index));
+  }
+
+  iterator begin() {
+    return iterator(this, 0);
+  }
+
+  iterator end() {
+    return iterator(this, size());
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(this, size());
+  }
+
+  bool has_value(size_type index) const {
+    return (mPresence[index / optional_detail::presence_word_bits] &
+            optional_detail::presence_mask(index)) != 0;
+  }
+
+  size_type count_engaged() const {
+    size_type count = 0;
+    for (size_type i = 0; i < mPresence.size(); ++i) {
+      count += optional_detail::popcount(mPresence[i]);
+    }
+    return count;
+  }
+
+  const T* values() const {
+    return mValues.empty() ? 0 : &mValues[0];
+  }
+
+  const uint64_t* presence() const {
+    return mPresence.empty() ? 0 : &mPresence[0];
+  }
+
+  size_type presence_words() const {
+    return mPresence.size();
+  }
+
+  void swap(optional_vector& other) {
+    mValues.swap(other.mValues);
+    mPresence.swap(other.mPresence);
+  }
+
+  friend void swap(optional_vector& a, optional_vector& b) {
+    a.swap(b);
+  }
+
+ private:
+  std::vector<T> mValues;
+  std::vector<uint64_t> mPresence;
+
+  // Makes room for the presence word of the next value before that value is
+  // appended, so that a throwing copy or allocation cannot leave the bitmap
+  // and the values with different sizes.
+  void reservePresence() {
+    if (mValues.size() % optional_detail::presence_word_bits == 0 &&
+        mPresence.size() == mPresence.capacity()) {
+      mPresence.reserve(std::max<size_type>(1, 2 * mPresence.capacity()));
+    }
+  }
+
+  // Cannot throw after reservePresence.
+  void appendPresence(bool hasValue) {
+    const size_type index = mValues.size() - 1;
+    if (index % optional_detail::presence_word_bits == 0) {
+      mPresence.push_back(0);
+    }
+    if (hasValue) {
+      mPresence.back() |= optional_detail::presence_mask(index);
+    }
+  }
+
+  void clearUnusedBits() {
+    const size_type usedBits =
+        mValues.size() % optional_detail::presence_word_bits;
+    if (usedBits != 0) {
+      mPresence.back() &= (uint64_t(1) << usedBits) - 1;
+    }
+  }
+};
+
+#endif  // OPTIONALCPP_OPTIONAL_VECTOR_HPP
@@ -0,0 +1,86 @@
+#ifndef OPTIONALCPP_PADDED_OPTIONAL_HPP
+#define OPTIONALCPP_PADDED_OPTIONAL_HPP
+
+#include <cstddef>
+
+#include "optional.hpp"
+
+namespace optional_detail {
+
+template <typename T, std::size_t Alignment>
+struct padded_alignment {
+  static const std::size_t natural = alignment_of<optional<T> >::value;
+  static const std::size_t value = Alignment > natural ? Alignment : natural;
+};
+
+}  // namespace optional_detail
+
+#if __cplusplus >= 201103L
+#define OPTIONALCPP_ALIGNED(N) alignas(N)
+#elif defined(__GNUC__)
+#define OPTIONALCPP_ALIGNED(N) __attribute__((aligned(N)))
+#else
+#define OPTIONALCPP_ALIGNED(N)
+#endif
+
+const std::size_t cache_line_size = 64;
+
+// An optional that starts on its own Alignment boundary and is padded to a
+// multiple of it, so neighbouring elements of an array never share a cache
+// line.
+template <typename T, std::size_t Alignment = cache_line_size>
+class OPTIONALCPP_ALIGNED(
+    (optional_detail::padded_alignment<T, Alignment>::value)) padded_optional
+    : public optional<T> {
+  typedef optional<T> base;
+
+ public:
+  OPTIONALCPP_CONSTEXPR padded_optional() {}
+
+  OPTIONALCPP_CONSTEXPR padded_optional(const base& other)
+      : base(other) {}
+
+#if __cplusplus >= 201103L
+  using base::base;
+
+  constexpr padded_optional(base&& other)
+      : base(std::move(other)) {}
+#else
+  padded_optional(nullopt_t)
+      : base(nullopt) {}
+
+  padded_optional(const T& value)
+      : base(value) {}
+
+  explicit padded_optional(in_place_t)
+      : base(in_place) {}
+
+#define OPTIONALCPP_IN_PLACE_CONSTRUCTOR(N)                        \
+  template <OPTIONALCPP_TYPENAMES_##N>                             \
+  explicit padded_optional(in_place_t, OPTIONALCPP_PARAMETERS_##N) \
+      : base(in_place, OPTIONALCPP_ARGUMENTS_##N) {}
+
+  OPTIONALCPP_FOR_EACH_ARITY(OPTIONALCPP_IN_PLACE_CONSTRUCTOR)
+
+#undef OPTIONALCPP_IN_PLACE_CONSTRUCTOR
+#endif
+
+  using base::operator=;
+
+  padded_optional& operator=(nullopt_t) {
+    base::reset();
+    return *this;
+  }
+};
+
+namespace optional_detail {
+
+template <typename T, std::size_t Alignment>
+struct optional_layout<padded_optional<T, Alignment> >
+    : optional_layout<optional<T> > {};
+
+}  // namespace optional_detail
+
+#undef OPTIONALCPP_ALIGNED
+
+#endif  // OPTIONALCPP_PADDED_OPTIONAL_HPP
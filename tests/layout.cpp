@@ -0,0 +1,125 @@
+// Compiles only if the layouts of the optionals match the pinned numbers, so
+// that a change which costs memory fails the build.
+
+#include <stdint.h>
+
+#include <string>
+
+#include "compact_optional.hpp"
+#include "indirect_optional.hpp"
+#include "optional.hpp"
+#include "padded_optional.hpp"
+
+#if __cplusplus >= 201103L
+#define LAYOUT_ASSERT(condition) static_assert(condition, #condition)
+#else
+#define LAYOUT_CONCATENATE_IMPL(a, b) a##b
+#define LAYOUT_CONCATENATE(a, b) LAYOUT_CONCATENATE_IMPL(a, b)
+#define LAYOUT_ASSERT(condition)                            \
+  typedef char LAYOUT_CONCATENATE(layout_assert_, __LINE__) \
+      [(condition) ? 1 : -1]
+#endif
+
+struct Rgb {
+  char r;
+  char g;
+  char b;
+};
+
+struct Sparse {
+  int64_t a;
+  int8_t b;
+};
+
+typedef optional_traits<char> char_traits;
+typedef optional_traits<int16_t> int16_traits;
+typedef optional_traits<int32_t> int32_traits;
+typedef optional_traits<int64_t> int64_traits;
+typedef optional_traits<double> double_traits;
+typedef optional_traits<int*> pointer_traits;
+typedef optional_traits<int&> reference_traits;
+typedef optional_traits<Rgb> rgb_traits;
+typedef optional_traits<Sparse> sparse_traits;
+typedef optional_traits<std::string> string_traits;
+typedef optional_traits<int, compact_optional<int, value_sentinel<int, -1> > >
+    compact_int_traits;
+typedef optional_traits<double,
+                        compact_optional<double, nan_sentinel<double> > >
+    compact_double_traits;
+typedef optional_traits<int, padded_optional<int> > padded_traits;
+typedef optional_traits<int, padded_optional<int, 128> > wide_padded_traits;
+typedef optional_traits<Sparse, indirect_optional<Sparse> > indirect_traits;
+
+// Holds on every platform.
+LAYOUT_ASSERT(char_traits::size == 2);
+LAYOUT_ASSERT(char_traits::padding_bytes == 0);
+LAYOUT_ASSERT(rgb_traits::size == 4);
+LAYOUT_ASSERT(rgb_traits::padding_bytes == 0);
+LAYOUT_ASSERT(int32_traits::size == 2 * int32_traits::alignment);
+LAYOUT_ASSERT(string_traits::padding_bytes < string_traits::alignment);
+LAYOUT_ASSERT(string_traits::size % string_traits::alignment == 0);
+LAYOUT_ASSERT(reference_traits::size == sizeof(int*));
+LAYOUT_ASSERT(reference_traits::padding_bytes == 0);
+LAYOUT_ASSERT(compact_int_traits::size == sizeof(int));
+LAYOUT_ASSERT(compact_int_traits::padding_bytes == 0);
+LAYOUT_ASSERT(compact_double_traits::size == sizeof(double));
+LAYOUT_ASSERT(indirect_traits::size == sizeof(Sparse*));
+LAYOUT_ASSERT(indirect_traits::padding_bytes == 0);
+
+LAYOUT_ASSERT(!char_traits::uses_sentinel);
+LAYOUT_ASSERT(!string_traits::uses_sentinel);
+LAYOUT_ASSERT(reference_traits::uses_sentinel);
+LAYOUT_ASSERT(compact_int_traits::uses_sentinel);
+LAYOUT_ASSERT(compact_double_traits::uses_sentinel);
+LAYOUT_ASSERT(indirect_traits::uses_sentinel);
+LAYOUT_ASSERT(!padded_traits::uses_sentinel);
+
+LAYOUT_ASSERT(reference_traits::is_trivially_copyable);
+LAYOUT_ASSERT(compact_int_traits::is_trivially_copyable);
+LAYOUT_ASSERT(!string_traits::is_trivially_copyable);
+LAYOUT_ASSERT(!indirect_traits::is_trivially_copyable);
+
+#if __cplusplus >= 201103L || defined(__GNUC__)
+LAYOUT_ASSERT(padded_traits::size == 64);
+LAYOUT_ASSERT(padded_traits::alignment == 64);
+LAYOUT_ASSERT(wide_padded_traits::size == 128);
+LAYOUT_ASSERT(wide_padded_traits::alignment == 128);
+#endif
+
+// Instrumented optionals count their copies and are not trivially copyable.
+#if !defined(OPTIONALCPP_INSTRUMENTATION)
+LAYOUT_ASSERT(int64_traits::is_trivially_copyable);
+LAYOUT_ASSERT(pointer_traits::is_trivially_copyable);
+#if __cplusplus >= 201103L
+LAYOUT_ASSERT(rgb_traits::is_trivially_copyable);
+LAYOUT_ASSERT(sparse_traits::is_trivially_copyable);
+LAYOUT_ASSERT(std::is_trivially_copyable<optional<Sparse> >::value);
+#endif
+#endif
+
+#if __cplusplus >= 201103L
+LAYOUT_ASSERT(std::is_trivially_copyable<optional<int&> >::value);
+#endif
+
+// Pinned for 64 bit targets.
+#if defined(__LP64__) || defined(_WIN64)
+LAYOUT_ASSERT(int16_traits::size == 4);
+LAYOUT_ASSERT(int16_traits::padding_bytes == 1);
+LAYOUT_ASSERT(int32_traits::size == 8);
+LAYOUT_ASSERT(int32_traits::padding_bytes == 3);
+LAYOUT_ASSERT(int64_traits::size == 16);
+LAYOUT_ASSERT(int64_traits::alignment == 8);
+LAYOUT_ASSERT(int64_traits::padding_bytes == 7);
+LAYOUT_ASSERT(double_traits::size == 16);
+LAYOUT_ASSERT(double_traits::padding_bytes == 7);
+LAYOUT_ASSERT(pointer_traits::size == 16);
+LAYOUT_ASSERT(pointer_traits::padding_bytes == 7);
+LAYOUT_ASSERT(reference_traits::size == 8);
+LAYOUT_ASSERT(sparse_traits::size == 24);
+LAYOUT_ASSERT(sparse_traits::padding_bytes == 7);
+LAYOUT_ASSERT(compact_double_traits::size == 8);
+#if __cplusplus >= 201103L || defined(__GNUC__)
+LAYOUT_ASSERT(padded_traits::padding_bytes == 59);
+#endif
+LAYOUT_ASSERT(indirect_traits::size == 8);
+#endif
@@ -1,6 +1,31 @@
 #include "catch_with_main.hpp"
 #include "optional.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#if __cplusplus >= 201103L
+#include <thread>
+#include <unordered_map>
+#endif
+#if __cplusplus >= 201703L && __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+
+#if __cplusplus >= 201103L
+#include "atomic_optional.hpp"
+#endif
+#include "compact_optional.hpp"
+#include "indirect_optional.hpp"
+#include "optional_instrumentation.hpp"
+#include "optional_algorithms.hpp"
+#include "optional_serialization.hpp"
+#include "optional_span.hpp"
+#include "optional_vector.hpp"
+#include "padded_optional.hpp"
+
 typedef optional<unsigned int> optional_unsigned_int;
 
 TEST_CASE("A default constructed optional has no value.") {
@@ -349,7 +374,10 @@ TEST_CASE("An optional with a value destructs the value during destruction.") {
 
 TEST_CASE("value() will throw if it is called on an optional without a value") {
   const optional<int> empty;
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_THROW && \
+    !defined(OPTIONALCPP_NO_EXCEPTIONS)
   REQUIRE_THROWS_AS(empty.value(), bad_optional_access);
+#endif
 }
 
 struct GlobalCopyCounting {
@@ -525,3 +553,1911 @@ TEST_CASE(
   REQUIRE(not x);
 }
 
+
+struct MultiArgumentConstructable {
+  MultiArgumentConstructable(int a, const std::string& b, double c)
+      : a(a)
+      , b(b)
+      , c(c) {}
+
+  int a;
+  std::string b;
+  double c;
+};
+
+TEST_CASE(
+    "An optional constructed in place stores the value constructed from "
+    "the given arguments.") {
+  const optional<MultiArgumentConstructable> x(in_place, 1,
+                                               std::string("two"), 3.0);
+  REQUIRE(x.has_value());
+  REQUIRE(x->a == 1);
+  REQUIRE(x->b == "two");
+  REQUIRE(x->c == 3.0);
+}
+
+TEST_CASE(
+    "An optional constructed in place without arguments stores a value "
+    "initialized value.") {
+  const optional<int> x(in_place);
+  REQUIRE(x.has_value());
+  REQUIRE(*x == 0);
+}
+
+TEST_CASE("emplace constructs a value from the given arguments.") {
+  optional<MultiArgumentConstructable> x;
+  MultiArgumentConstructable& value = x.emplace(1, std::string("two"), 3.0);
+  REQUIRE(x.has_value());
+  REQUIRE(&value == &(*x));
+  REQUIRE(x->a == 1);
+  REQUIRE(x->b == "two");
+  REQUIRE(x->c == 3.0);
+}
+
+TEST_CASE("emplace does not copy the value type.") {
+  optional<CopyCounting> x;
+  x.emplace();
+  REQUIRE(x->copyCount == 0);
+  const optional<CopyCounting> y(in_place);
+  REQUIRE(y->copyCount == 0);
+}
+
+TEST_CASE("emplace on an optional with a value destructs the old value.") {
+  {
+    optional<CheckedDestructorCalls> x(in_place);
+    REQUIRE(CheckedDestructorCalls::missingDestructorCalls == 1);
+    x.emplace();
+    REQUIRE(CheckedDestructorCalls::missingDestructorCalls == 1);
+  }
+  REQUIRE(CheckedDestructorCalls::missingDestructorCalls == 0);
+}
+
+#if __cplusplus >= 201103L
+struct MoveOnly {
+  explicit MoveOnly(int x)
+      : x(x) {}
+  MoveOnly(const MoveOnly&) = delete;
+  MoveOnly(MoveOnly&& other) noexcept
+      : x(other.x) {
+    other.x = 0;
+  }
+  MoveOnly& operator=(const MoveOnly&) = delete;
+  MoveOnly& operator=(MoveOnly&& other) noexcept {
+    x = other.x;
+    other.x = 0;
+    return *this;
+  }
+
+  int x;
+};
+
+TEST_CASE("An optional of a move only type can be moved.") {
+  SECTION("move constructor with a value") {
+    optional<MoveOnly> x(MoveOnly(5));
+    optional<MoveOnly> y(std::move(x));
+    REQUIRE(y.has_value());
+    REQUIRE(y->x == 5);
+    REQUIRE(x.has_value());
+    REQUIRE(x->x == 0);
+  }
+
+  SECTION("move constructor without a value") {
+    optional<MoveOnly> x;
+    optional<MoveOnly> y(std::move(x));
+    REQUIRE(not y.has_value());
+  }
+
+  SECTION("move assignment with a value to an optional without a value") {
+    optional<MoveOnly> x(MoveOnly(5));
+    optional<MoveOnly> y;
+    y = std::move(x);
+    REQUIRE(y->x == 5);
+    REQUIRE(x->x == 0);
+  }
+
+  SECTION("move assignment with a value to an optional with a value") {
+    optional<MoveOnly> x(MoveOnly(5));
+    optional<MoveOnly> y(MoveOnly(3));
+    y = std::move(x);
+    REQUIRE(y->x == 5);
+    REQUIRE(x->x == 0);
+  }
+
+  SECTION("move assignment without a value to an optional with a value") {
+    optional<MoveOnly> x;
+    optional<MoveOnly> y(MoveOnly(3));
+    y = std::move(x);
+    REQUIRE(not y.has_value());
+  }
+
+  SECTION("swap of an optional with a value and one without a value") {
+    optional<MoveOnly> x(MoveOnly(5));
+    optional<MoveOnly> y;
+    swap(x, y);
+    REQUIRE(not x.has_value());
+    REQUIRE(y->x == 5);
+  }
+}
+
+struct ThrowingMove {
+  ThrowingMove() {}
+  ThrowingMove(const ThrowingMove&) {}
+  ThrowingMove(ThrowingMove&&) {}
+  ThrowingMove& operator=(const ThrowingMove&) {
+    return *this;
+  }
+  ThrowingMove& operator=(ThrowingMove&&) {
+    return *this;
+  }
+};
+
+TEST_CASE("The move operations of an optional propagate noexcept.") {
+  STATIC_REQUIRE(
+      std::is_nothrow_move_constructible<optional<MoveOnly> >::value);
+  STATIC_REQUIRE(std::is_nothrow_move_assignable<optional<MoveOnly> >::value);
+  STATIC_REQUIRE(noexcept(std::declval<optional<MoveOnly>&>().swap(
+      std::declval<optional<MoveOnly>&>())));
+  STATIC_REQUIRE(
+      not std::is_nothrow_move_constructible<optional<ThrowingMove> >::value);
+  STATIC_REQUIRE(
+      not std::is_nothrow_move_assignable<optional<ThrowingMove> >::value);
+}
+
+struct MoveAndCopyCounting {
+  MoveAndCopyCounting() {}
+  MoveAndCopyCounting(const MoveAndCopyCounting&) {
+    ++copyCount;
+  }
+  MoveAndCopyCounting(MoveAndCopyCounting&&) noexcept {}
+
+  static int copyCount;
+};
+
+int MoveAndCopyCounting::copyCount = 0;
+
+TEST_CASE(
+    "A vector of optionals moves instead of copying its elements during "
+    "reallocation.") {
+  std::vector<optional<MoveAndCopyCounting> > v;
+  MoveAndCopyCounting::copyCount = 0;
+  for (int i = 0; i < 100; ++i) {
+    v.push_back(optional<MoveAndCopyCounting>(in_place));
+  }
+  REQUIRE(MoveAndCopyCounting::copyCount == 0);
+}
+#endif
+
+TEST_CASE(
+    "Swapping an optional with a value and one without a value relocates the "
+    "value without copying it.") {
+  std::vector<int> anyValueX;
+  anyValueX.push_back(1);
+  anyValueX.push_back(2);
+  optional<std::vector<int> > x(anyValueX);
+  optional<std::vector<int> > y;
+  const int* storage = &(*x)[0];
+
+  SECTION("this has value") {
+    x.swap(y);
+  }
+  SECTION("other has value") {
+    y.swap(x);
+  }
+
+  REQUIRE(not x.has_value());
+  REQUIRE(y.has_value());
+  REQUIRE(*y == anyValueX);
+  REQUIRE(&(*y)[0] == storage);
+}
+
+struct NonDefaultConstructableWithValue {
+  explicit NonDefaultConstructableWithValue(int x)
+      : x(x) {}
+
+  int x;
+};
+
+TEST_CASE(
+    "Swapping an optional with a value and one without a value works for "
+    "non default constructable types.") {
+  optional<NonDefaultConstructableWithValue> x(
+      NonDefaultConstructableWithValue(5));
+  optional<NonDefaultConstructableWithValue> y;
+
+  swap(x, y);
+
+  REQUIRE(not x.has_value());
+  REQUIRE(y->x == 5);
+}
+
+TEST_CASE("Scalar types are trivially relocatable, strings are not.") {
+  REQUIRE(is_trivially_relocatable<int>::value);
+  REQUIRE(is_trivially_relocatable<double>::value);
+  REQUIRE(is_trivially_relocatable<const char*>::value);
+  REQUIRE(not is_trivially_relocatable<std::string>::value);
+}
+
+// Instrumented optionals give up their trivial special members.
+#if __cplusplus >= 201103L && !defined(OPTIONALCPP_INSTRUMENTATION)
+struct TriviallyDestructibleOnly {
+  TriviallyDestructibleOnly() {}
+  TriviallyDestructibleOnly(const TriviallyDestructibleOnly&) {}
+};
+
+TEST_CASE(
+    "An optional of a trivially copyable type is trivially copyable itself.") {
+  STATIC_REQUIRE(std::is_trivially_copyable<optional<int> >::value);
+  STATIC_REQUIRE(std::is_trivially_copyable<optional<A> >::value);
+  STATIC_REQUIRE(std::is_trivially_destructible<optional<int> >::value);
+  STATIC_REQUIRE(std::is_trivially_destructible<
+                 optional<TriviallyDestructibleOnly> >::value);
+  STATIC_REQUIRE(not std::is_trivially_copyable<
+                 optional<TriviallyDestructibleOnly> >::value);
+  STATIC_REQUIRE(not std::is_trivially_copyable<optional<std::string> >::value);
+  STATIC_REQUIRE(
+      not std::is_trivially_destructible<optional<std::string> >::value);
+}
+#endif
+
+TEST_CASE(
+    "An optional of a trivially copyable type keeps its state when "
+    "copied.") {
+  int anyValue = 5;
+  optional<int> x(anyValue);
+  optional<int> y;
+  optional<int> x2(x);
+  optional<int> y2(y);
+  REQUIRE(x2 == x);
+  REQUIRE(not y2.has_value());
+  y2 = x;
+  x2 = y;
+  REQUIRE(*y2 == anyValue);
+  REQUIRE(not x2.has_value());
+}
+
+typedef compact_optional<int, value_sentinel<int, INT_MIN> > compact_int;
+typedef compact_optional<double, nan_sentinel<double> > compact_double;
+
+TEST_CASE("A compact optional is not larger than its value type.") {
+  REQUIRE(sizeof(compact_int) == sizeof(int));
+  REQUIRE(sizeof(compact_double) == sizeof(double));
+  REQUIRE(sizeof(compact_optional<int*, null_sentinel<int*> >) ==
+          sizeof(int*));
+}
+
+TEST_CASE("A default constructed compact optional has no value.") {
+  const compact_int x;
+  const compact_double y;
+  const compact_optional<int*, null_sentinel<int*> > z = nullopt;
+  REQUIRE(not x.has_value());
+  REQUIRE(not y);
+  REQUIRE(not z);
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_THROW && \
+    !defined(OPTIONALCPP_NO_EXCEPTIONS)
+  REQUIRE_THROWS_AS(x.value(), bad_optional_access);
+#endif
+}
+
+TEST_CASE("A compact optional constructed with a value stores the value.") {
+  int anyValue = 5;
+  compact_int x(anyValue);
+  REQUIRE(x.has_value());
+  REQUIRE(*x == anyValue);
+  REQUIRE(x.value() == anyValue);
+  x.reset();
+  REQUIRE(not x.has_value());
+  x.emplace(anyValue);
+  REQUIRE(*x == anyValue);
+}
+
+TEST_CASE("A compact optional compares like an optional.") {
+  compact_double empty;
+  compact_double one(1.0);
+  compact_double two(2.0);
+  REQUIRE(empty == empty);
+  REQUIRE(empty == nullopt);
+  REQUIRE(empty < one);
+  REQUIRE(one < two);
+  REQUIRE(one != two);
+  REQUIRE(two >= one);
+  REQUIRE(one == 1.0);
+  REQUIRE(empty < 1.0);
+  REQUIRE(nullopt < one);
+  REQUIRE(not(one <= nullopt));
+}
+
+TEST_CASE("Swapping compact optionals swaps their states.") {
+  compact_int x(5);
+  compact_int y;
+  swap(x, y);
+  REQUIRE(not x.has_value());
+  REQUIRE(*y == 5);
+}
+
+struct empty_string_sentinel {
+  static std::string empty_value() {
+    return std::string();
+  }
+
+  static bool is_empty(const std::string& value) {
+    return value.empty();
+  }
+};
+
+typedef compact_optional<std::string, empty_string_sentinel> compact_string;
+
+TEST_CASE("A compact optional has the constructors of an optional.") {
+  const compact_string x(in_place, 3, 'x');
+  REQUIRE(*x == "xxx");
+  compact_string y;
+  REQUIRE(y.emplace(2, 'y') == "yy");
+  y = std::string("abc");
+  REQUIRE(*y == "abc");
+  y = "de";
+  REQUIRE(*y == "de");
+  compact_int z;
+  z = 4;
+  REQUIRE(*z == 4);
+  z = nullopt;
+  REQUIRE(not z);
+#if __cplusplus >= 201103L
+  std::string value(100, 'v');
+  const char* const buffer = value.data();
+  const compact_string moved(std::move(value));
+  REQUIRE(moved->data() == buffer);
+#endif
+}
+
+#if __cplusplus >= 201103L
+TEST_CASE("A compact optional has the monadic operations of an optional.") {
+  const compact_int x(3);
+  const compact_int empty;
+  const auto half = [](int i) {
+    return i % 2 == 0 ? compact_int(i / 2) : compact_int();
+  };
+  REQUIRE(compact_int(8).and_then(half) == 4);
+  REQUIRE(x.and_then(half) == nullopt);
+  REQUIRE(empty.and_then(half) == nullopt);
+
+  const optional<std::string> stars =
+      x.transform([](int i) { return std::string(i, '*'); });
+  REQUIRE(stars == std::string("***"));
+  REQUIRE(empty.transform([](int i) { return i + 1; }) == nullopt);
+
+  REQUIRE(empty.or_else([] { return compact_int(1); }) == 1);
+  REQUIRE(x.or_else([] { return compact_int(1); }) == 3);
+  REQUIRE(&x.value_or(*x) == &*x);
+}
+#endif
+
+template <typename T>
+struct tightly_packed_optional_size {
+  static const std::size_t value =
+      (sizeof(T) + 1 + alignment_of<T>::value - 1) / alignment_of<T>::value *
+      alignment_of<T>::value;
+};
+
+struct ThreeChars {
+  char c[3];
+};
+
+#if __cplusplus >= 201103L
+#define REQUIRE_TIGHTLY_PACKED(T) \
+  STATIC_REQUIRE(sizeof(optional<T>) == tightly_packed_optional_size<T>::value)
+#else
+#define REQUIRE_TIGHTLY_PACKED(T) \
+  REQUIRE(sizeof(optional<T>) == tightly_packed_optional_size<T>::value)
+#endif
+
+TEST_CASE(
+    "An optional is as large as its value plus one byte rounded up to the "
+    "alignment of the value.") {
+  REQUIRE_TIGHTLY_PACKED(char);
+  REQUIRE_TIGHTLY_PACKED(short);
+  REQUIRE_TIGHTLY_PACKED(int);
+  REQUIRE_TIGHTLY_PACKED(double);
+  REQUIRE_TIGHTLY_PACKED(long double);
+  REQUIRE_TIGHTLY_PACKED(ThreeChars);
+  REQUIRE_TIGHTLY_PACKED(A);
+  REQUIRE_TIGHTLY_PACKED(std::string);
+  REQUIRE_TIGHTLY_PACKED(optional<short>);
+  REQUIRE_TIGHTLY_PACKED(optional<ThreeChars>);
+}
+
+#undef REQUIRE_TIGHTLY_PACKED
+
+TEST_CASE("The value of an optional is stored without leading padding.") {
+  ThreeChars anyValue = {{'a', 'b', 'c'}};
+  const optional<ThreeChars> x(anyValue);
+  REQUIRE(static_cast<const void*>(&x) == static_cast<const void*>(&(*x)));
+}
+
+// The size is the same with the flag in front of the value, so only the byte
+// right after the value shows where the flag is. The engaged values are zero,
+// so that a flag in front would leave a zero byte there.
+template <typename T>
+bool stores_flag_after_value() {
+  const optional<T> engaged = T();
+  const optional<T> empty;
+  return reinterpret_cast<const char*>(&*engaged)[sizeof(T)] == 1 &&
+         reinterpret_cast<const char*>(&empty)[sizeof(T)] == 0;
+}
+
+TEST_CASE("The flag of an optional is stored right after the value.") {
+  REQUIRE(stores_flag_after_value<char>());
+  REQUIRE(stores_flag_after_value<int>());
+  REQUIRE(stores_flag_after_value<double>());
+  REQUIRE(stores_flag_after_value<ThreeChars>());
+  REQUIRE(stores_flag_after_value<std::string>());
+  REQUIRE(stores_flag_after_value<optional<short> >());
+}
+
+template <std::size_t N>
+struct has_alignment {
+  static const bool value =
+      alignment_of<typename type_with_alignment<N>::type>::value == N;
+};
+
+TEST_CASE("type_with_alignment yields a type of the requested alignment.") {
+  REQUIRE(has_alignment<1>::value);
+  REQUIRE(has_alignment<2>::value);
+  REQUIRE(has_alignment<4>::value);
+  REQUIRE(has_alignment<8>::value);
+  REQUIRE(has_alignment<16>::value);
+  REQUIRE(has_alignment<32>::value);
+  REQUIRE(has_alignment<64>::value);
+}
+
+TEST_CASE("aligned_storage is aligned as requested and not oversized.") {
+  typedef aligned_storage<sizeof(float), alignment_of<float>::value>
+      float_storage;
+  typedef aligned_storage<sizeof(double), alignment_of<double>::value>
+      double_storage;
+  typedef aligned_storage<64, 64> cache_line_storage;
+  REQUIRE(alignment_of<float_storage>::value == alignment_of<float>::value);
+  REQUIRE(sizeof(float_storage) == sizeof(float));
+  REQUIRE(alignment_of<double_storage>::value == alignment_of<double>::value);
+  REQUIRE(sizeof(double_storage) == sizeof(double));
+  REQUIRE(alignment_of<cache_line_storage>::value == 64);
+  REQUIRE(sizeof(cache_line_storage) == 64);
+}
+
+#if __cplusplus >= 201103L
+struct alignas(32) OverAligned {
+  float values[8];
+};
+
+TEST_CASE("An optional can store an over-aligned type.") {
+  REQUIRE(alignment_of<optional<OverAligned> >::value == 32);
+  REQUIRE(sizeof(optional<OverAligned>) == 64);
+  const optional<OverAligned> x(in_place);
+  REQUIRE(reinterpret_cast<std::size_t>(&(*x)) % 32 == 0);
+}
+#endif
+
+TEST_CASE("value_or returns the value or the given default.") {
+  const optional<int> empty;
+  const optional<int> x(5);
+  REQUIRE(empty.value_or(3) == 3);
+  REQUIRE(x.value_or(3) == 5);
+  const compact_int compactEmpty;
+  REQUIRE(compactEmpty.value_or(3) == 3);
+}
+
+#if __cplusplus >= 201103L
+TEST_CASE("value_or returns a reference to an lvalue default.") {
+  const optional<std::string> empty;
+  const optional<std::string> x("value");
+  const std::string fallback("fallback");
+  REQUIRE(&empty.value_or(fallback) == &fallback);
+  REQUIRE(&x.value_or(fallback) == &(*x));
+  REQUIRE(empty.value_or("literal") == "literal");
+  REQUIRE(optional<std::string>("moved").value_or(fallback) == "moved");
+  REQUIRE(optional<std::string>().value_or(fallback) == "fallback");
+}
+
+optional<int> parseDigit(char c) {
+  return c >= '0' && c <= '9' ? optional<int>(c - '0') : optional<int>();
+}
+
+TEST_CASE("and_then chains functions returning optionals.") {
+  const optional<char> digit('7');
+  const optional<char> letter('x');
+  REQUIRE(digit.and_then(parseDigit) == 7);
+  REQUIRE(letter.and_then(parseDigit) == nullopt);
+  REQUIRE(optional<char>().and_then(parseDigit) == nullopt);
+  REQUIRE(optional<char>('3').and_then(parseDigit) == 3);
+}
+
+TEST_CASE("transform applies a function to the value of an optional.") {
+  const optional<int> x(4);
+  const optional<std::string> s =
+      x.transform([](int i) { return std::string(i, '*'); });
+  REQUIRE(s == std::string("****"));
+  REQUIRE(optional<int>().transform([](int i) { return i + 1; }) == nullopt);
+  optional<std::string> moved("abc");
+  REQUIRE(std::move(moved).transform([](std::string&& v) {
+    return v.size();
+  }) == 3u);
+}
+
+TEST_CASE("or_else returns the optional or the result of the function.") {
+  const optional<int> x(4);
+  const optional<int> empty;
+  auto fallback = [] { return optional<int>(9); };
+  REQUIRE(x.or_else(fallback) == 4);
+  REQUIRE(empty.or_else(fallback) == 9);
+  REQUIRE(optional<int>().or_else([] { return optional<int>(); }) == nullopt);
+}
+
+#if __cplusplus >= 201703L
+struct Immovable {
+  explicit Immovable(int value)
+      : mValue(value) {}
+
+  Immovable(const Immovable&) = delete;
+  Immovable& operator=(const Immovable&) = delete;
+
+  int mValue;
+};
+
+TEST_CASE("transform constructs the result in place.") {
+  const optional<int> x(5);
+  const optional<Immovable> y = x.transform([](int i) { return Immovable(i); });
+  REQUIRE(y->mValue == 5);
+}
+#endif
+#endif
+
+#if __cplusplus >= 201103L && !defined(OPTIONALCPP_INSTRUMENTATION)
+constexpr optional<int> constexprTable[4] = {optional<int>(), 1, nullopt,
+                                             optional<int>(in_place, 3)};
+
+TEST_CASE(
+    "An optional of a literal type can be used in constant expressions.") {
+  STATIC_REQUIRE(not constexprTable[0].has_value());
+  STATIC_REQUIRE(constexprTable[1].has_value());
+  STATIC_REQUIRE(*constexprTable[1] == 1);
+  STATIC_REQUIRE(not constexprTable[2]);
+  STATIC_REQUIRE(constexprTable[3].value_or(0) == 3);
+  STATIC_REQUIRE(constexprTable[0].value_or(7) == 7);
+  STATIC_REQUIRE(constexprTable[0] == nullopt);
+  STATIC_REQUIRE(constexprTable[0] < constexprTable[1]);
+  STATIC_REQUIRE(constexprTable[1] < constexprTable[3]);
+  STATIC_REQUIRE(constexprTable[1] != constexprTable[3]);
+  STATIC_REQUIRE(constexprTable[3] == 3);
+  STATIC_REQUIRE(constexprTable[3] >= 2);
+  STATIC_REQUIRE(constexprTable[0] == constexprTable[2]);
+}
+#endif
+
+#if __cplusplus >= 201103L
+constexpr compact_int constexprCompact(5);
+
+TEST_CASE("A compact optional can be used in constant expressions.") {
+  STATIC_REQUIRE(constexprCompact.has_value());
+  STATIC_REQUIRE(*constexprCompact == 5);
+  STATIC_REQUIRE(constexprCompact > nullopt);
+}
+#endif
+
+TEST_CASE(
+    "Optionals of arithmetic types which lost their value compare like empty "
+    "optionals.") {
+  optional<long> x(5);
+  optional<long> y(7);
+  x.reset();
+  const optional<long> empty;
+  const optional<long> seven(7);
+  REQUIRE(x == empty);
+  REQUIRE(not(x < empty));
+  REQUIRE(x < seven);
+  REQUIRE(not(seven < x));
+  y = nullopt;
+  REQUIRE(x == y);
+  REQUIRE(not(x < y));
+  REQUIRE(not(y < x));
+  REQUIRE(x != seven);
+}
+
+TEST_CASE("Comparisons of arithmetic optionals match the general ordering.") {
+  const double values[] = {-1.0, 0.0, 2.5};
+  optional<double> candidates[4];
+  for (int i = 0; i < 3; ++i) {
+    candidates[i + 1] = values[i];
+  }
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      const optional<double>& a = candidates[i];
+      const optional<double>& b = candidates[j];
+      REQUIRE((a == b) == (i == j));
+      REQUIRE((a < b) == (i < j));
+      REQUIRE((a <= b) == (i <= j));
+      REQUIRE((a > b) == (i > j));
+    }
+  }
+}
+
+TEST_CASE("An optional vector stores values and empty elements.") {
+  optional_vector<int> v;
+  REQUIRE(v.empty());
+  v.push_back(1);
+  v.push_back(nullopt);
+  v.push_back(optional<int>(3));
+  v.push_back(optional<int>());
+  REQUIRE(v.size() == 4);
+  REQUIRE(v[0] == 1);
+  REQUIRE(v[1] == nullopt);
+  REQUIRE(*v[2] == 3);
+  REQUIRE(not v[3].has_value());
+  REQUIRE(v.has_value(2));
+  REQUIRE(not v.has_value(3));
+  REQUIRE(v.count_engaged() == 2);
+}
+
+TEST_CASE(
+    "The elements of an optional vector can be assigned like optionals.") {
+  optional_vector<int> v(3);
+  REQUIRE(v.count_engaged() == 0);
+  v[0] = 5;
+  v[1] = optional<int>(6);
+  v[2] = v[1];
+  REQUIRE(v.count_engaged() == 3);
+  REQUIRE(v[2] == 6);
+  v[1] = nullopt;
+  v[2].reset();
+  REQUIRE(v.count_engaged() == 1);
+  const optional<int> x = v[0];
+  REQUIRE(x == 5);
+  REQUIRE(v[1].value_or(7) == 7);
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_THROW && \
+    !defined(OPTIONALCPP_NO_EXCEPTIONS)
+  REQUIRE_THROWS_AS(v[1].value(), bad_optional_access);
+#endif
+  REQUIRE(v[1] < v[0]);
+  REQUIRE(v[0] > 4);
+}
+
+TEST_CASE("Elements of an optional vector can be swapped.") {
+  optional_vector<std::string> v;
+  v.push_back(std::string("a"));
+  v.push_back(nullopt);
+  swap(v[0], v[1]);
+  REQUIRE(not v[0].has_value());
+  REQUIRE(*v[1] == "a");
+  REQUIRE(v[1]->size() == 1);
+}
+
+bool isEven(const optional<int>& x) {
+  return x.has_value() && *x % 2 == 0;
+}
+
+TEST_CASE("An optional vector can be iterated like a vector of optionals.") {
+  optional_vector<int> v;
+  for (int i = 0; i < 100; ++i) {
+    if (i % 3 == 0) {
+      v.push_back(nullopt);
+    } else {
+      v.push_back(i);
+    }
+  }
+  int sum = 0;
+  for (optional_vector<int>::const_iterator it = v.begin(); it != v.end();
+       ++it) {
+    sum += (*it).value_or(0);
+  }
+  REQUIRE(sum == 3267);
+  REQUIRE(v.end() - v.begin() == 100);
+  REQUIRE(std::count_if(v.begin(), v.end(), isEven) == 33);
+  REQUIRE(std::find(v.begin(), v.end(), optional<int>(5)) - v.begin() == 5);
+
+  std::reverse(v.begin(), v.end());
+  REQUIRE(v[0] == nullopt);
+  REQUIRE(v[1] == 98);
+  REQUIRE(v[99] == nullopt);
+  REQUIRE(v.count_engaged() == 66);
+  optional_vector<int>::iterator last = v.end();
+  *--last = 7;
+  REQUIRE(v[99] == 7);
+  REQUIRE(v.begin()[99] == 7);
+#if __cplusplus >= 201103L
+  int engaged = 0;
+  for (const auto x : v) {
+    engaged += x.has_value();
+  }
+  REQUIRE(engaged == 67);
+#endif
+}
+
+#if __cplusplus >= 201103L
+TEST_CASE("An optional vector moves values that are pushed back.") {
+  optional_vector<std::string> v;
+  std::string value(100, 'v');
+  const char* const buffer = value.data();
+  v.push_back(std::move(value));
+  REQUIRE(v[0]->data() == buffer);
+}
+#endif
+
+#if !defined(OPTIONALCPP_NO_EXCEPTIONS)
+struct ThrowingCopy {
+  ThrowingCopy()
+      : mThrows(false) {}
+
+  explicit ThrowingCopy(bool throws)
+      : mThrows(throws) {}
+
+  ThrowingCopy(const ThrowingCopy& other)
+      : mThrows(other.mThrows) {
+    if (mThrows) {
+      throw std::runtime_error("copy");
+    }
+  }
+
+  ThrowingCopy& operator=(const ThrowingCopy& other) {
+    mThrows = other.mThrows;
+    return *this;
+  }
+
+  bool mThrows;
+};
+
+TEST_CASE("A throwing push_back leaves an optional vector unchanged.") {
+  optional_vector<ThrowingCopy> v;
+  for (int i = 0; i < 64; ++i) {
+    v.push_back(ThrowingCopy(false));
+  }
+  REQUIRE_THROWS_AS(v.push_back(ThrowingCopy(true)), std::runtime_error);
+  REQUIRE(v.size() == 64);
+  REQUIRE(v.presence_words() == 1);
+  REQUIRE(v.count_engaged() == 64);
+  v.push_back(nullopt);
+  REQUIRE(v.presence_words() == 2);
+  REQUIRE(not v.has_value(64));
+}
+#endif
+
+TEST_CASE("An optional vector counts engaged elements across many words.") {
+  optional_vector<double> v;
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 3 == 0) {
+      v.push_back(double(i));
+    } else {
+      v.push_back(nullopt);
+    }
+  }
+  REQUIRE(v.presence_words() == 16);
+  REQUIRE(v.count_engaged() == 334);
+  v.resize(10);
+  REQUIRE(v.count_engaged() == 4);
+  v.pop_back();
+  REQUIRE(v.count_engaged() == 3);
+  v.resize(100);
+  REQUIRE(v.count_engaged() == 3);
+  const optional_vector<double> engaged(70, 1.5);
+  REQUIRE(engaged.count_engaged() == 70);
+  REQUIRE(engaged[69] == 1.5);
+}
+
+TEST_CASE("Bulk algorithms over an optional vector skip empty elements.") {
+  optional_vector<int> v;
+  for (int i = 0; i < 150; ++i) {
+    if (i % 3 == 0) {
+      v.push_back(i);
+    } else {
+      v.push_back(nullopt);
+    }
+  }
+  REQUIRE(count_engaged(v) == 50);
+  std::vector<int> filled(v.size());
+  value_or_fill(v, -1, &filled[0]);
+  std::vector<int> compacted(v.size());
+  REQUIRE(compact_engaged(v, &compacted[0]) == 50);
+  for (int i = 0; i < 150; ++i) {
+    REQUIRE(filled[i] == (i % 3 == 0 ? i : -1));
+  }
+  for (int i = 0; i < 50; ++i) {
+    REQUIRE(compacted[i] == 3 * i);
+  }
+  REQUIRE(sum_engaged(v) == 3675);
+  REQUIRE(min_engaged(v) == 0);
+  REQUIRE(max_engaged(v) == 147);
+  uint64_t equal[3];
+  equal_engaged(v, 0, equal);
+  REQUIRE(equal[0] == 1);
+  REQUIRE(equal[1] == 0);
+  REQUIRE(equal[2] == 0);
+  equal_engaged(v, 1, equal);
+  REQUIRE(equal[0] == 0);
+}
+
+TEST_CASE("Bulk algorithms handle 8-byte values and partial words.") {
+  optional_vector<double> v;
+  for (int i = 0; i < 67; ++i) {
+    if (i % 2 == 1) {
+      v.push_back(double(i));
+    } else {
+      v.push_back(nullopt);
+    }
+  }
+  std::vector<double> filled(v.size());
+  value_or_fill(v, 0.5, &filled[0]);
+  for (int i = 0; i < 67; ++i) {
+    REQUIRE(filled[i] == (i % 2 == 1 ? double(i) : 0.5));
+  }
+  REQUIRE(sum_engaged(v) == 1089.0);
+  REQUIRE(min_engaged(v) == 1.0);
+  REQUIRE(max_engaged(v) == 65.0);
+  uint64_t equal[2];
+  equal_engaged(v, 65.0, equal);
+  REQUIRE(equal[0] == 0);
+  REQUIRE(equal[1] == 2);
+  const optional_vector<double> empty(5);
+  REQUIRE(min_engaged(empty) == nullopt);
+  REQUIRE(max_engaged(empty) == nullopt);
+  REQUIRE(sum_engaged(empty) == 0.0);
+}
+
+TEST_CASE("Bulk minimum and maximum agree with ranges of optionals.") {
+  const double inf = std::numeric_limits<double>::infinity();
+  const double big = std::numeric_limits<double>::max();
+  const double cases[][3] = {
+      {inf, inf, inf}, {-inf, -inf, -inf}, {big, -big, big}, {-inf, big, inf}};
+  for (std::size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+    optional_vector<double> v;
+    std::vector<optional<double> > a;
+    for (int i = 0; i < 70; ++i) {
+      const optional<double> o =
+          i % 3 == 0 ? optional<double>(cases[c][i % 9 / 3]) : nullopt;
+      v.push_back(o);
+      a.push_back(o);
+    }
+    const optional<double>* first = &a[0];
+    REQUIRE(min_engaged(v) == min_engaged(first, first + a.size()));
+    REQUIRE(max_engaged(v) == max_engaged(first, first + a.size()));
+  }
+  const optional_vector<double> positive(3, inf);
+  REQUIRE(min_engaged(positive) == inf);
+  const optional_vector<double> negative(3, -inf);
+  REQUIRE(max_engaged(negative) == -inf);
+}
+
+TEST_CASE("Bulk algorithms accept ranges of optionals.") {
+  const optional<int> values[] = {3, nullopt, -2, nullopt, 7};
+  const optional<int>* last = values + 5;
+  REQUIRE(count_engaged(values, last) == 3);
+  int filled[5];
+  value_or_fill(values, last, 0, filled);
+  REQUIRE(filled[1] == 0);
+  REQUIRE(filled[4] == 7);
+  int compacted[5];
+  REQUIRE(compact_engaged(values, last, compacted) == 3);
+  REQUIRE(compacted[1] == -2);
+  REQUIRE(sum_engaged(values, last) == 8);
+  REQUIRE(min_engaged(values, last) == -2);
+  REQUIRE(max_engaged(values, last) == 7);
+  uint64_t equal[1];
+  equal_engaged(values, last, 7, equal);
+  REQUIRE(equal[0] == 0x10);
+  std::vector<optional<int> > many(70, optional<int>(7));
+  many[65] = nullopt;
+  uint64_t manyEqual[2];
+  equal_engaged(&many[0], &many[0] + many.size(), 7, manyEqual);
+  REQUIRE(manyEqual[0] == ~uint64_t(0));
+  REQUIRE(manyEqual[1] == 0x3d);
+}
+
+// The vector kernels compare blocks of lanes; the last block of a word must
+// not shift by the full word width.
+TEST_CASE("equal_engaged fills whole and partial last words.") {
+  for (int size = 120; size <= 136; size += 8) {
+    optional_vector<int> v;
+    for (int i = 0; i < size; ++i) {
+      v.push_back(4);
+    }
+    uint64_t equal[3] = {0, 0, 0};
+    equal_engaged(v, 4, equal);
+    REQUIRE(equal[0] == ~uint64_t(0));
+    const int tail = size - 64;
+    REQUIRE(equal[1] ==
+            (tail >= 64 ? ~uint64_t(0) : (uint64_t(1) << tail) - 1));
+    REQUIRE(equal[2] == (size > 128 ? (uint64_t(1) << (size - 128)) - 1 : 0));
+  }
+}
+
+TEST_CASE("An optional reference is a single pointer.") {
+  REQUIRE(sizeof(optional<int&>) == sizeof(int*));
+  REQUIRE(sizeof(optional<const std::string&>) == sizeof(std::string*));
+#if __cplusplus >= 201103L
+  STATIC_REQUIRE(std::is_trivially_copyable<optional<int&> >::value);
+  STATIC_REQUIRE(std::is_trivially_copyable<optional<std::string&> >::value);
+  STATIC_REQUIRE(
+      not std::is_constructible<optional<const int&>, int&&>::value);
+#endif
+}
+
+TEST_CASE("An optional reference refers to the original object.") {
+  std::string s("original");
+  optional<std::string&> x(s);
+  REQUIRE(x.has_value());
+  REQUIRE(&(*x) == &s);
+  REQUIRE(&x.value() == &s);
+  x->append("!");
+  REQUIRE(s == "original!");
+  const optional<std::string&> copy(x);
+  *copy = "changed";
+  REQUIRE(s == "changed");
+  x.reset();
+  REQUIRE(not x);
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_THROW && \
+    !defined(OPTIONALCPP_NO_EXCEPTIONS)
+  REQUIRE_THROWS_AS(x.value(), bad_optional_access);
+#endif
+  REQUIRE(copy.has_value());
+}
+
+TEST_CASE("An optional reference can be rebound, swapped and compared.") {
+  int a = 1;
+  int b = 2;
+  optional<int&> x;
+  optional<int&> y(b);
+  REQUIRE(x == nullopt);
+  REQUIRE(x < y);
+  REQUIRE(&x.emplace(a) == &a);
+  REQUIRE(x < y);
+  REQUIRE(x == 1);
+  swap(x, y);
+  REQUIRE(&(*x) == &b);
+  REQUIRE(&(*y) == &a);
+  y = nullopt;
+  int fallback = 3;
+  REQUIRE(&y.value_or(fallback) == &fallback);
+  REQUIRE(&x.value_or(fallback) == &b);
+  const optional<const int&> z(a);
+  REQUIRE(z == *x - 1);
+}
+
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_THROW && \
+    defined(OPTIONALCPP_NO_EXCEPTIONS)
+struct handled_bad_access {};
+
+void throwHandledBadAccess() {
+  throw handled_bad_access();
+}
+
+TEST_CASE("Without exceptions a bad access calls the installed handler.") {
+  REQUIRE(set_bad_optional_access_handler(throwHandledBadAccess) == 0);
+  REQUIRE(get_bad_optional_access_handler() == throwHandledBadAccess);
+  const optional<int> empty;
+  REQUIRE_THROWS_AS(empty.value(), handled_bad_access);
+  REQUIRE(set_bad_optional_access_handler(0) == throwHandledBadAccess);
+}
+#endif
+
+#if __cplusplus >= 201103L
+TEST_CASE("Hashing an optional forwards to the hash of its value.") {
+  const std::hash<optional<std::string> > hasher;
+  const optional<std::string> x("key");
+  REQUIRE(hasher(x) == std::hash<std::string>()("key"));
+  REQUIRE(hasher(optional<std::string>()) ==
+          std::hash<optional<int> >()(optional<int>()));
+  REQUIRE(hasher(optional<std::string>()) != std::hash<int>()(0));
+  std::string key("key");
+  REQUIRE(std::hash<optional<const std::string&> >()(key) == hasher(x));
+}
+
+TEST_CASE("hash_range hashes ranges of optionals.") {
+  optional<int> values[] = {1, nullopt, 3};
+  std::size_t hashes[3];
+  REQUIRE(hash_range(values, values + 3, hashes) == hashes + 3);
+  const std::hash<optional<int> > hasher;
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(hashes[i] == hasher(values[i]));
+  }
+  const std::vector<optional<std::string> > strings = {std::string("a"),
+                                                       nullopt};
+  std::vector<std::size_t> stringHashes;
+  hash_range(strings.begin(), strings.end(),
+             std::back_inserter(stringHashes));
+  REQUIRE(stringHashes.size() == 2);
+  REQUIRE(stringHashes[1] == hasher(nullopt));
+  optional_vector<double> v;
+  v.push_back(2.5);
+  v.push_back(nullopt);
+  std::size_t vectorHashes[2];
+  REQUIRE(hash_range(v, vectorHashes) == vectorHashes + 2);
+  REQUIRE(vectorHashes[0] == std::hash<double>()(2.5));
+  REQUIRE(vectorHashes[1] == hasher(nullopt));
+}
+
+TEST_CASE("Optionals can be used as keys of unordered containers.") {
+  std::unordered_map<optional<int>, int> counts;
+  ++counts[1];
+  ++counts[nullopt];
+  ++counts[1];
+  REQUIRE(counts.size() == 2);
+  REQUIRE(counts[1] == 2);
+  REQUIRE(counts[nullopt] == 1);
+}
+#endif
+
+#if defined(OPTIONALCPP_THREE_WAY_COMPARISON)
+struct ThreeWayCounting {
+  int x;
+
+  friend bool operator==(const ThreeWayCounting& a, const ThreeWayCounting& b) {
+    return a.x == b.x;
+  }
+
+  friend std::strong_ordering operator<=>(const ThreeWayCounting& a,
+                                          const ThreeWayCounting& b) {
+    ++count;
+    return a.x <=> b.x;
+  }
+
+  static int count;
+};
+
+int ThreeWayCounting::count = 0;
+
+TEST_CASE("Optionals are three-way comparable in C++20.") {
+#if !defined(OPTIONALCPP_INSTRUMENTATION)
+  STATIC_REQUIRE((optional<int>(1) <=> optional<int>(2)) < 0);
+  STATIC_REQUIRE((optional<int>() <=> optional<int>()) == 0);
+  STATIC_REQUIRE((optional<int>() <=> optional<int>(0)) < 0);
+  STATIC_REQUIRE((optional<int>(3) <=> 3) == 0);
+  STATIC_REQUIRE((4 <=> optional<int>(3)) > 0);
+  STATIC_REQUIRE((optional<int>() <=> nullopt) == 0);
+  STATIC_REQUIRE((nullopt <=> optional<int>(1)) < 0);
+#endif
+  STATIC_REQUIRE(
+      std::is_same_v<decltype(optional<double>() <=> optional<double>()),
+                     std::partial_ordering>);
+  const optional<std::string> a("abc");
+  REQUIRE(a > std::string("abb"));
+  REQUIRE(a <= "abc");
+  REQUIRE(std::string("abd") >= a);
+}
+
+TEST_CASE("Relational operators compare the values of optionals only once.") {
+  const optional<ThreeWayCounting> a(ThreeWayCounting{1});
+  const optional<ThreeWayCounting> b(ThreeWayCounting{2});
+  ThreeWayCounting::count = 0;
+  REQUIRE(a < b);
+  REQUIRE(not(a >= b));
+  REQUIRE(b > ThreeWayCounting{1});
+  REQUIRE(ThreeWayCounting{2} <= b);
+  REQUIRE(ThreeWayCounting::count == 4);
+}
+
+TEST_CASE("Relational operators of arithmetic optionals order NaN like <=>.") {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const optional<double> values[] = {optional<double>(), optional<double>(nan),
+                                     optional<double>(-1.0),
+                                     optional<double>(2.0)};
+  for (const optional<double>& a : values) {
+    for (const optional<double>& b : values) {
+      REQUIRE((a < b) == ((a <=> b) < 0));
+      REQUIRE((a > b) == ((a <=> b) > 0));
+      REQUIRE((a <= b) == ((a <=> b) <= 0));
+      REQUIRE((a >= b) == ((a <=> b) >= 0));
+    }
+  }
+#if !defined(OPTIONALCPP_INSTRUMENTATION)
+  STATIC_REQUIRE(optional<int>() < optional<int>(0));
+  STATIC_REQUIRE(optional<int>(1) >= optional<int>(1));
+  STATIC_REQUIRE(not(optional<int>(2) <= optional<int>()));
+#endif
+}
+#endif
+
+struct ConversionCounting {
+  explicit ConversionCounting(int value)
+      : x(value) {}
+
+  int x;
+
+  static int conversions;
+};
+
+int ConversionCounting::conversions = 0;
+
+struct ConvertibleToCounting {
+  int x;
+
+  operator ConversionCounting() const {
+    ++ConversionCounting::conversions;
+    return ConversionCounting(x);
+  }
+};
+
+bool operator==(const ConversionCounting& a, const ConvertibleToCounting& b) {
+  return a.x == b.x;
+}
+
+bool operator<(const ConversionCounting& a, const ConvertibleToCounting& b) {
+  return a.x < b.x;
+}
+
+bool operator<(const ConvertibleToCounting& a, const ConversionCounting& b) {
+  return a.x < b.x;
+}
+
+TEST_CASE("Optionals of different types compare their values directly.") {
+  const optional<std::string> s("abc");
+  const optional<const char*> c("abc");
+  const optional<const char*> d("abd");
+  const optional<const char*> emptyC;
+  const optional<std::string> emptyS;
+  REQUIRE(s == c);
+  REQUIRE(c == s);
+  REQUIRE(s != d);
+  REQUIRE(s < d);
+  REQUIRE(d > s);
+  REQUIRE(s <= c);
+  REQUIRE(s >= c);
+  REQUIRE(emptyS == emptyC);
+  REQUIRE(emptyS != c);
+  REQUIRE(emptyS < c);
+  REQUIRE(not(emptyC < emptyS));
+  REQUIRE(optional<int>(1) == optional<long>(1));
+  REQUIRE(optional<int>(1) < compact_int(2));
+  REQUIRE(compact_int() == optional<long>());
+}
+
+TEST_CASE("Comparing optionals of different types converts no values.") {
+  const optional<ConversionCounting> a(in_place, 1);
+  ConvertibleToCounting two = {2};
+  const optional<ConvertibleToCounting> b(two);
+  ConversionCounting::conversions = 0;
+  REQUIRE(not(a == b));
+  REQUIRE(a != b);
+  REQUIRE(a < b);
+  REQUIRE(b > a);
+  REQUIRE(not(a >= b));
+  REQUIRE(a <= b);
+  REQUIRE(ConversionCounting::conversions == 0);
+}
+
+#if __cplusplus >= 201103L
+struct FourInts {
+  int a;
+  int b;
+  int c;
+  int d;
+};
+
+TEST_CASE("An atomic optional of a small type packs into one atomic word.") {
+  STATIC_REQUIRE(not atomic_optional<int>::uses_seqlock);
+  STATIC_REQUIRE(atomic_optional<FourInts>::uses_seqlock);
+  atomic_optional<int> x;
+  REQUIRE(x.is_lock_free());
+  REQUIRE(x.load() == nullopt);
+  x.store(5);
+  REQUIRE(x.load() == 5);
+  REQUIRE(x.exchange(nullopt) == 5);
+  REQUIRE(x.load() == nullopt);
+  optional<int> expected(1);
+  REQUIRE(not x.compare_exchange(expected, 2));
+  REQUIRE(expected == nullopt);
+  REQUIRE(x.compare_exchange(expected, 2));
+  REQUIRE(x.load() == 2);
+  x.reset();
+  REQUIRE(not x.load().has_value());
+  atomic_optional<int> zero(optional<int>(0));
+  REQUIRE(zero.load() == 0);
+}
+
+TEST_CASE("An atomic optional of a larger type uses a seqlock.") {
+  const FourInts value = {1, 2, 3, 4};
+  atomic_optional<FourInts> x(value);
+  REQUIRE(x.load()->c == 3);
+  const FourInts other = {5, 6, 7, 8};
+  optional<FourInts> expected;
+  REQUIRE(not x.compare_exchange(expected, other));
+  REQUIRE(expected->d == 4);
+  REQUIRE(x.compare_exchange(expected, other));
+  REQUIRE(x.exchange(nullopt)->a == 5);
+  REQUIRE(not x.load().has_value());
+}
+
+TEST_CASE("Readers of an atomic optional never see torn values.") {
+  atomic_optional<FourInts> slot;
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0);
+  std::thread reader([&] {
+    while (not done.load()) {
+      const optional<FourInts> value = slot.load();
+      if (value && (value->a != value->b || value->a != value->d)) {
+        ++torn;
+      }
+    }
+  });
+  for (int i = 0; i < 20000; ++i) {
+    const FourInts value = {i, i, i, i};
+    slot.store(i % 3 == 0 ? optional<FourInts>() : optional<FourInts>(value));
+  }
+  done.store(true);
+  reader.join();
+  REQUIRE(torn.load() == 0);
+}
+
+TEST_CASE("compare_exchange on an atomic optional is atomic.") {
+  atomic_optional<int> counter(optional<int>(0));
+  const FourInts zeros = {0, 0, 0, 0};
+  atomic_optional<FourInts> wide(zeros);
+  std::thread threads[4];
+  for (int t = 0; t < 4; ++t) {
+    threads[t] = std::thread([&] {
+      for (int i = 0; i < 1000; ++i) {
+        optional<int> expected = counter.load();
+        while (not counter.compare_exchange(expected, *expected + 1)) {
+        }
+        optional<FourInts> wideExpected = wide.load();
+        FourInts next;
+        do {
+          next = *wideExpected;
+          ++next.a;
+        } while (not wide.compare_exchange(wideExpected, next));
+      }
+    });
+  }
+  for (int t = 0; t < 4; ++t) {
+    threads[t].join();
+  }
+  REQUIRE(counter.load() == 4000);
+  REQUIRE(wide.load()->a == 4000);
+}
+#endif
+
+TEST_CASE("A padded optional occupies whole cache lines.") {
+  REQUIRE(sizeof(padded_optional<char>) == 64);
+  REQUIRE(alignment_of<padded_optional<char> >::value == 64);
+  typedef padded_optional<int, 128> wide_optional;
+  REQUIRE(sizeof(wide_optional) == 128);
+  REQUIRE(alignment_of<wide_optional>::value == 128);
+  REQUIRE(sizeof(padded_optional<std::string>) % 64 == 0);
+
+  padded_optional<int> values[2];
+  REQUIRE(reinterpret_cast<const char*>(&values[1]) -
+              reinterpret_cast<const char*>(&values[0]) ==
+          64);
+}
+
+TEST_CASE("A padded optional keeps the interface of an optional.") {
+  padded_optional<int> x = 1;
+  padded_optional<int, 128> y(in_place, 2);
+  padded_optional<int> empty;
+  REQUIRE(*x == 1);
+  REQUIRE(y.value() == 2);
+  REQUIRE(!empty);
+
+  REQUIRE(x < y);
+  REQUIRE(x != empty);
+  REQUIRE(x == 1);
+  REQUIRE(x == optional<int>(1));
+  REQUIRE(empty == nullopt);
+
+  x.swap(empty);
+  REQUIRE(!x);
+  REQUIRE(*empty == 1);
+  swap(x, empty);
+  REQUIRE(*x == 1);
+
+  x.reset();
+  REQUIRE(!x);
+  y = nullopt;
+  REQUIRE(!y);
+  x.emplace(3);
+  REQUIRE(x.value_or(0) == 3);
+  x = optional<int>(4);
+  REQUIRE(*x == 4);
+}
+
+struct LargeRecord {
+  explicit LargeRecord(int id)
+      : mId(id) {}
+
+  int mId;
+  char mPayload[2048];
+};
+
+class RecordPool {
+ public:
+  RecordPool()
+      : mLive(0), mFreeCount(0) {}
+
+  ~RecordPool() {
+    for (int i = 0; i < mFreeCount; ++i) {
+      ::operator delete(mFree[i]);
+    }
+  }
+
+  void* allocate() {
+    ++mLive;
+    return mFreeCount > 0 ? mFree[--mFreeCount]
+                          : ::operator new(sizeof(LargeRecord));
+  }
+
+  void deallocate(void* block) {
+    --mLive;
+    mFree[mFreeCount++] = block;
+  }
+
+  int live() const {
+    return mLive;
+  }
+
+ private:
+  int mLive;
+  void* mFree[8];
+  int mFreeCount;
+};
+
+template <typename T>
+struct PoolAllocator {
+  typedef T value_type;
+
+  explicit PoolAllocator(RecordPool& pool)
+      : mPool(&pool) {}
+
+  T* allocate(std::size_t) {
+    return static_cast<T*>(mPool->allocate());
+  }
+
+  void deallocate(T* pointer, std::size_t) {
+    mPool->deallocate(pointer);
+  }
+
+  friend bool operator==(const PoolAllocator& a, const PoolAllocator& b) {
+    return a.mPool == b.mPool;
+  }
+
+  friend bool operator!=(const PoolAllocator& a, const PoolAllocator& b) {
+    return a.mPool != b.mPool;
+  }
+
+  RecordPool* mPool;
+};
+
+typedef indirect_optional<LargeRecord, PoolAllocator<LargeRecord> >
+    pooled_record;
+
+TEST_CASE("An indirect optional stores only a pointer.") {
+  REQUIRE(sizeof(indirect_optional<LargeRecord>) == sizeof(LargeRecord*));
+  REQUIRE(sizeof(pooled_record) == 2 * sizeof(LargeRecord*));
+}
+
+TEST_CASE("An indirect optional allocates from its pool only when engaged.") {
+  RecordPool pool;
+  pooled_record x((PoolAllocator<LargeRecord>(pool)));
+  REQUIRE(!x);
+  REQUIRE(pool.live() == 0);
+
+  x.emplace(1);
+  REQUIRE(pool.live() == 1);
+  REQUIRE(x->mId == 1);
+  const LargeRecord* const block = &*x;
+
+  x.reset();
+  REQUIRE(pool.live() == 0);
+  x.emplace(2);
+  REQUIRE(&*x == block);
+
+  {
+    pooled_record copy = x;
+    REQUIRE(pool.live() == 2);
+    REQUIRE(copy->mId == 2);
+  }
+  REQUIRE(pool.live() == 1);
+  x = nullopt;
+  REQUIRE(pool.live() == 0);
+}
+
+TEST_CASE("Swapping indirect optionals swaps their pointers.") {
+  RecordPool pool;
+  pooled_record a(LargeRecord(1), PoolAllocator<LargeRecord>(pool));
+  pooled_record b((PoolAllocator<LargeRecord>(pool)));
+  const LargeRecord* const block = &*a;
+  swap(a, b);
+  REQUIRE(!a);
+  REQUIRE(&*b == block);
+  a.swap(b);
+  REQUIRE(&*a == block);
+  REQUIRE(pool.live() == 1);
+}
+
+#if __cplusplus >= 201103L
+template <typename T>
+struct PropagatingPoolAllocator : PoolAllocator<T> {
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  explicit PropagatingPoolAllocator(RecordPool& pool)
+      : PoolAllocator<T>(pool) {}
+};
+
+typedef indirect_optional<LargeRecord, PropagatingPoolAllocator<LargeRecord> >
+    propagating_record;
+
+TEST_CASE("Indirect optionals propagate allocators as the traits say.") {
+  RecordPool first;
+  RecordPool second;
+  const PropagatingPoolAllocator<LargeRecord> firstAllocator(first);
+  const PropagatingPoolAllocator<LargeRecord> secondAllocator(second);
+  STATIC_REQUIRE(std::is_nothrow_move_assignable<propagating_record>::value);
+
+  propagating_record a(LargeRecord(1), firstAllocator);
+  propagating_record b(LargeRecord(2), secondAllocator);
+  a = b;
+  REQUIRE(a.get_allocator() == secondAllocator);
+  REQUIRE(a->mId == 2);
+  REQUIRE(first.live() == 0);
+  REQUIRE(second.live() == 2);
+
+  propagating_record c((firstAllocator));
+  c.swap(a);
+  REQUIRE(!a);
+  REQUIRE(a.get_allocator() == firstAllocator);
+  REQUIRE(c.get_allocator() == secondAllocator);
+
+  a = std::move(c);
+  REQUIRE(a.get_allocator() == secondAllocator);
+  REQUIRE(!c);
+  REQUIRE(second.live() == 2);
+}
+#endif
+
+#if __cplusplus >= 201703L && __has_include(<memory_resource>)
+typedef indirect_optional<std::string,
+                          std::pmr::polymorphic_allocator<std::string> >
+    pmr_string;
+
+TEST_CASE("Indirect optionals work with polymorphic allocators.") {
+  std::pmr::unsynchronized_pool_resource pool;
+  std::pmr::monotonic_buffer_resource arena;
+  STATIC_REQUIRE(!std::is_nothrow_move_assignable_v<pmr_string>);
+
+  pmr_string a(std::string("a"), &pool);
+  pmr_string b(std::string("b"), &pool);
+  a.swap(b);
+  REQUIRE(*a == "b");
+  REQUIRE(*b == "a");
+
+  // Copies use the default resource, as the containers of std::pmr do.
+  const pmr_string copy = a;
+  REQUIRE(copy.get_allocator().resource() ==
+          std::pmr::get_default_resource());
+
+  pmr_string c(std::string("c"), &arena);
+  c = a;
+  REQUIRE(c.get_allocator().resource() == &arena);
+  REQUIRE(*c == "b");
+
+  const std::string* const block = &*b;
+  a = std::move(b);
+  REQUIRE(&*a == block);
+  REQUIRE(!b);
+  c = std::move(a);
+  REQUIRE(c.get_allocator().resource() == &arena);
+  REQUIRE(*c == "a");
+  REQUIRE(a.has_value());
+}
+#endif
+
+TEST_CASE("An indirect optional keeps the interface of an optional.") {
+  indirect_optional<int> x = 3;
+  indirect_optional<int> y(in_place, 4);
+  const indirect_optional<int> empty;
+  REQUIRE(x.value() == 3);
+  REQUIRE(x == 3);
+  REQUIRE(x < y);
+  REQUIRE(x != empty);
+  REQUIRE(empty == nullopt);
+  REQUIRE(empty.value_or(5) == 5);
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_THROW && \
+    !defined(OPTIONALCPP_NO_EXCEPTIONS)
+  REQUIRE_THROWS_AS(empty.value(), bad_optional_access);
+#endif
+
+  const int* const block = &*x;
+  x = y;
+  REQUIRE(*x == 4);
+  REQUIRE(&*x == block);
+}
+
+// Copies serialized data into storage aligned like a memory mapped file.
+std::vector<uint64_t> alignedCopy(const std::string& bytes) {
+  std::vector<uint64_t> storage((bytes.size() + 7) / 8);
+  std::memcpy(&storage[0], bytes.data(), bytes.size());
+  return storage;
+}
+
+TEST_CASE("Serialized optionals are a presence bitmap and dense values.") {
+  const optional<int> values[] = {1, nullopt, 3};
+  std::ostringstream stream;
+  optional_writer<int, std::ostringstream> writer(stream);
+  writer.write(values, values + 3);
+
+  const std::string bytes = stream.str();
+  REQUIRE(bytes.size() == serialized_size<int>(3));
+  REQUIRE(bytes.size() == 40);
+  REQUIRE(writer.bytes_written() == 40);
+  const std::vector<uint64_t> storage = alignedCopy(bytes);
+  REQUIRE(storage[1] == 3);
+  REQUIRE(storage[2] == 5);
+  int dense[3];
+  std::memcpy(dense, &storage[3], sizeof(dense));
+  REQUIRE(dense[0] == 1);
+  REQUIRE(dense[1] == 0);
+  REQUIRE(dense[2] == 3);
+}
+
+TEST_CASE("A serialized block is read in place without copying.") {
+  optional_vector<double> values;
+  for (int i = 0; i < 100; ++i) {
+    if (i % 3 == 0) {
+      values.push_back(nullopt);
+    } else {
+      values.push_back(i * 0.5);
+    }
+  }
+  std::ostringstream stream;
+  optional_writer<double, std::ostringstream> writer(stream);
+  writer.write(values);
+  const std::vector<uint64_t> storage = alignedCopy(stream.str());
+
+  const optional_array_view<double> view(&storage[0], stream.str().size());
+  REQUIRE(view.valid());
+  REQUIRE(view.size() == 100);
+  REQUIRE(view.byte_size() == stream.str().size());
+  REQUIRE(view.count_engaged() == values.count_engaged());
+  REQUIRE(reinterpret_cast<const char*>(view.values()) >
+          reinterpret_cast<const char*>(&storage[0]));
+  REQUIRE(!view[0]);
+  REQUIRE(view[1] == 0.5);
+  REQUIRE(view[98].value_or(-1.0) == 49.0);
+  REQUIRE(view[99].value_or(-1.0) == -1.0);
+  REQUIRE(sum_engaged(view.values(), view.presence(), view.size()) ==
+          sum_engaged(values));
+}
+
+TEST_CASE("A stream of serialized blocks is read block by block.") {
+  std::ostringstream stream;
+  optional_writer<int, std::ostringstream> writer(stream);
+  const optional<int> first[] = {1, 2};
+  const optional<int> second[] = {nullopt};
+  writer.write(first, first + 2);
+  writer.write(second, second + 1);
+  writer.write(second, second);
+  const std::string bytes = stream.str();
+  const std::vector<uint64_t> storage = alignedCopy(bytes);
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(&storage[0]);
+
+  const optional_array_view<int> a(data, bytes.size());
+  const optional_array_view<int> b(data + a.byte_size(),
+                                   bytes.size() - a.byte_size());
+  const std::size_t offset = a.byte_size() + b.byte_size();
+  const optional_array_view<int> c(data + offset, bytes.size() - offset);
+  REQUIRE(a.valid());
+  REQUIRE(b.valid());
+  REQUIRE(c.valid());
+  REQUIRE(a[1] == 2);
+  REQUIRE(b.size() == 1);
+  REQUIRE(!b[0]);
+  REQUIRE(c.empty());
+  REQUIRE(offset + c.byte_size() == bytes.size());
+}
+
+TEST_CASE("Corrupt serialized blocks are rejected.") {
+  const optional<int> values[] = {1, 2, 3};
+  std::ostringstream stream;
+  optional_writer<int, std::ostringstream> writer(stream);
+  writer.write(values, values + 3);
+  std::vector<uint64_t> storage = alignedCopy(stream.str());
+  const std::size_t bytes = stream.str().size();
+
+  REQUIRE(optional_array_view<int>(&storage[0], bytes).valid());
+  REQUIRE(!optional_array_view<int>(&storage[0], bytes - 1).valid());
+  REQUIRE(!optional_array_view<short>(&storage[0], bytes).valid());
+  REQUIRE(!optional_array_view<int>().valid());
+  storage[1] = ~uint64_t(0);
+  REQUIRE(!optional_array_view<int>(&storage[0], bytes).valid());
+  storage[1] = 3;
+  storage[0] ^= 1;
+  REQUIRE(!optional_array_view<int>(&storage[0], bytes).valid());
+}
+
+#if __cplusplus >= 201103L
+struct IntPair {
+  int32_t a;
+  int32_t b;
+};
+
+struct CharAndInt {
+  char c;
+  int32_t i;
+};
+
+TEST_CASE("Only types without padding bytes are serialized.") {
+  STATIC_REQUIRE(optional_detail::has_no_padding<int>::value);
+  STATIC_REQUIRE(optional_detail::has_no_padding<double>::value);
+  STATIC_REQUIRE(not optional_detail::has_no_padding<long double>::value);
+  STATIC_REQUIRE(not optional_detail::has_no_padding<CharAndInt>::value);
+#if __cplusplus >= 201703L
+  STATIC_REQUIRE(optional_detail::has_no_padding<IntPair>::value);
+#endif
+}
+#endif
+
+TEST_CASE("Stray presence bits past the end of a block are not counted.") {
+  const optional<int> values[] = {1, nullopt, 3};
+  std::ostringstream stream;
+  optional_writer<int, std::ostringstream> writer(stream);
+  writer.write(values, values + 3);
+  std::vector<uint64_t> storage = alignedCopy(stream.str());
+  storage[2] |= ~uint64_t(0) << 3;
+  const optional_array_view<int> view(&storage[0], stream.str().size());
+  REQUIRE(view.valid());
+  REQUIRE(view.count_engaged() == 2);
+}
+
+TEST_CASE("An optional span views external values and validity bits.") {
+  const int values[] = {10, 20, 30, 40};
+  const uint64_t validity[] = {0x5 | (uint64_t(1) << 63)};
+  const optional_span<int> span(values, validity, 4);
+  REQUIRE(span.size() == 4);
+  REQUIRE(&*span[0] == &values[0]);
+  REQUIRE(span[0] == 10);
+  REQUIRE(!span[1]);
+  REQUIRE(span[1] == nullopt);
+  REQUIRE(span[1].value_or(-1) == -1);
+  REQUIRE(span[2].value() == 30);
+  REQUIRE(span[0] < span[2]);
+  REQUIRE(span[1] < span[0]);
+  REQUIRE(span[2] == optional<int>(30));
+  REQUIRE(!span.has_value(3));
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_THROW && \
+    !defined(OPTIONALCPP_NO_EXCEPTIONS)
+  REQUIRE_THROWS_AS(span[3].value(), bad_optional_access);
+#endif
+}
+
+TEST_CASE("Bulk algorithms ignore validity bits past the end of a span.") {
+  int values[100];
+  uint64_t validity[2] = {~uint64_t(0), ~uint64_t(0)};
+  for (int i = 0; i < 100; ++i) {
+    values[i] = i;
+  }
+  validity[0] &= ~uint64_t(1);
+  const optional_span<int> span(values, validity, 100);
+  REQUIRE(span.count_engaged() == 99);
+  REQUIRE(count_engaged(span) == 99);
+  REQUIRE(sum_engaged(span) == 4950);
+  REQUIRE(max_engaged(span) == 99);
+  REQUIRE(min_engaged(span) == 1);
+  int compacted[128];
+  REQUIRE(compact_engaged(span, compacted) == 99);
+  REQUIRE(compacted[98] == 99);
+
+  const optional_span<int> tail = span.subspan(64, 36);
+  REQUIRE(tail.count_engaged() == 36);
+  REQUIRE(tail[0] == 64);
+  REQUIRE(sum_engaged(tail) ==
+          sum_engaged(span) - sum_engaged(span.subspan(0, 64)));
+}
+
+TEST_CASE("An optional span can view an optional vector.") {
+  optional_vector<int> v;
+  v.push_back(1);
+  v.push_back(nullopt);
+  const optional_span<int> span = v;
+  REQUIRE(span.size() == 2);
+  REQUIRE(span[0] == 1);
+  REQUIRE(!span[1]);
+}
+
+struct EightArguments {
+  EightArguments(int a1, int a2, int a3, int a4, int a5, int a6, int a7,
+                 int a8)
+      : sum(a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8) {
+    ++constructions;
+  }
+
+  EightArguments(const EightArguments& other)
+      : sum(other.sum) {
+    ++copies;
+  }
+
+  int sum;
+
+  static int constructions;
+  static int copies;
+};
+
+int EightArguments::constructions = 0;
+int EightArguments::copies = 0;
+
+TEST_CASE("Values are constructed in place from up to eight arguments.") {
+  EightArguments::constructions = 0;
+  EightArguments::copies = 0;
+  optional<EightArguments> x(in_place, 1, 2, 3, 4, 5, 6, 7, 8);
+  REQUIRE(x->sum == 36);
+  x.emplace(2, 2, 2, 2, 2, 2, 2, 2);
+  REQUIRE(x->sum == 16);
+
+  padded_optional<EightArguments> padded(in_place, 1, 1, 1, 1, 1, 1, 1, 1);
+  REQUIRE(padded->sum == 8);
+  indirect_optional<EightArguments> indirect(in_place, 1, 1, 1, 1, 1, 1, 1,
+                                             2);
+  REQUIRE(indirect->sum == 9);
+  indirect.emplace(0, 0, 0, 0, 0, 0, 0, 1);
+  REQUIRE(indirect->sum == 1);
+
+  REQUIRE(EightArguments::constructions == 5);
+  REQUIRE(EightArguments::copies == 0);
+}
+
+struct AssignmentCounting {
+  AssignmentCounting() {
+    ++constructions;
+  }
+
+  AssignmentCounting(const AssignmentCounting&) {
+    ++constructions;
+  }
+
+  ~AssignmentCounting() {
+    ++destructions;
+  }
+
+  AssignmentCounting& operator=(const AssignmentCounting&) {
+    ++assignments;
+    return *this;
+  }
+
+  static void resetCounts() {
+    constructions = 0;
+    destructions = 0;
+    assignments = 0;
+  }
+
+  static int constructions;
+  static int destructions;
+  static int assignments;
+};
+
+int AssignmentCounting::constructions = 0;
+int AssignmentCounting::destructions = 0;
+int AssignmentCounting::assignments = 0;
+
+TEST_CASE("Assigning a value to an optional needs no temporary optional.") {
+  const AssignmentCounting value;
+  optional<AssignmentCounting> x;
+  AssignmentCounting::resetCounts();
+  x = value;
+  REQUIRE(AssignmentCounting::constructions == 1);
+  REQUIRE(AssignmentCounting::assignments == 0);
+  x = value;
+  REQUIRE(AssignmentCounting::constructions == 1);
+  REQUIRE(AssignmentCounting::assignments == 1);
+  REQUIRE(AssignmentCounting::destructions == 0);
+
+  indirect_optional<AssignmentCounting> indirect;
+  AssignmentCounting::resetCounts();
+  indirect = value;
+  const AssignmentCounting* const block = &*indirect;
+  indirect = value;
+  REQUIRE(&*indirect == block);
+  REQUIRE(AssignmentCounting::constructions == 1);
+  REQUIRE(AssignmentCounting::assignments == 1);
+  REQUIRE(AssignmentCounting::destructions == 0);
+}
+
+TEST_CASE("Assigning a convertible value reuses the contained string.") {
+  optional<std::string> x = std::string(64, 'a');
+  const char* const data = x->data();
+  x = "short";
+  REQUIRE(*x == "short");
+  REQUIRE(x->data() == data);
+
+  padded_optional<std::string> padded;
+  padded = "padded";
+  REQUIRE(*padded == "padded");
+}
+#if __cplusplus >= 201103L
+
+TEST_CASE("Assigning an rvalue moves into the contained value.") {
+  optional<std::string> x = std::string("a");
+  std::string value(64, 'b');
+  const char* const data = value.data();
+  x = std::move(value);
+  REQUIRE(x->data() == data);
+}
+#endif
+
+TEST_CASE("Events are counted only with instrumentation.") {
+  reset_optional_counters();
+  {
+    optional<long> a(1);
+    optional<long> b = a;
+    b.reset();
+    a.swap(b);
+  }
+  const optional_counters counters = get_optional_counters<long>();
+#if defined(OPTIONALCPP_INSTRUMENTATION)
+  REQUIRE(counters.constructions == 2);
+  REQUIRE(counters.copies == 1);
+  REQUIRE(counters.destructions == 2);
+  REQUIRE(counters.swaps == 1);
+#else
+  REQUIRE(counters.constructions == 0);
+  REQUIRE(counters.copies == 0);
+  REQUIRE(counters.destructions == 0);
+  REQUIRE(counters.swaps == 0);
+#endif
+}
+#if defined(OPTIONALCPP_INSTRUMENTATION)
+
+struct InstrumentedValue {
+  InstrumentedValue() {}
+  InstrumentedValue(const InstrumentedValue&) {}
+  InstrumentedValue& operator=(const InstrumentedValue&) {
+    return *this;
+  }
+  ~InstrumentedValue() {}
+};
+
+int bad_access_events = 0;
+
+void countBadAccess(optional_event event, const char*) {
+  if (event == optional_bad_access) {
+    ++bad_access_events;
+  }
+}
+
+bool swapped_types_found = false;
+
+void findInstrumentedValue(const char* name, const optional_counters& c) {
+  if (name == typeid(InstrumentedValue).name() && c.swaps == 1) {
+    swapped_types_found = true;
+  }
+}
+
+TEST_CASE("Instrumentation counts the events of each value type.") {
+  reset_optional_counters();
+  {
+    optional<InstrumentedValue> x(in_place);
+    optional<InstrumentedValue> y = x;
+    optional<InstrumentedValue> empty;
+    x = empty;
+    y.swap(empty);
+    empty.reset();
+  }
+  const optional_counters counters = get_optional_counters<InstrumentedValue>();
+  REQUIRE(counters.constructions == 3);
+  REQUIRE(counters.copies == 1);
+  REQUIRE(counters.destructions == 3);
+  REQUIRE(counters.swaps == 1);
+  REQUIRE(counters.bad_accesses == 0);
+
+  for_each_optional_counters(findInstrumentedValue);
+  REQUIRE(swapped_types_found);
+}
+
+TEST_CASE("Instrumentation calls the installed hook for bad accesses.") {
+  reset_optional_counters();
+  const optional_hook previous = set_optional_hook(countBadAccess);
+  const optional<InstrumentedValue> empty;
+  REQUIRE(get_optional_hook() == countBadAccess);
+#if OPTIONALCPP_ACCESS_MODE == OPTIONALCPP_ACCESS_THROW && \
+    !defined(OPTIONALCPP_NO_EXCEPTIONS)
+  REQUIRE_THROWS_AS(empty.value(), bad_optional_access);
+  REQUIRE(bad_access_events == 1);
+  REQUIRE(get_optional_counters<InstrumentedValue>().bad_accesses == 1);
+#endif
+  set_optional_hook(previous);
+}
+#endif